@@ -0,0 +1,356 @@
+#include "i2c_bus.h"
+
+uint8_t i2cWriteRead(TwoWire *i2c_interface,
+                     uint8_t address,
+                     uint8_t reg,
+                     uint8_t *out,
+                     uint8_t length) {
+  i2c_interface->beginTransmission(address);
+  i2c_interface->write(reg);
+  // false keeps the bus, the read below starts with a repeated START
+  if (i2c_interface->endTransmission(false) != 0) {
+    return 0;
+  }
+
+  uint8_t received = i2c_interface->requestFrom(address, length);
+  for (uint8_t i = 0; i < received; i++) {
+    out[i] = i2c_interface->read();
+  }
+  return received;
+}
+
+I2CDeviceHealth::I2CDeviceHealth() {
+  _online = true;
+  _failures = 0;
+  _dropouts = 0;
+  _skipped = 0;
+  _retry_at_ms = 0;
+  _retry_wait_ms = I2C_HEALTH_RETRY_MIN_MS;
+}
+
+bool I2CDeviceHealth::ready() {
+  return _online || (int32_t)(millis() - _retry_at_ms) >= 0;
+}
+
+void I2CDeviceHealth::record(bool ok) {
+  if (ok) {
+    _failures = 0;
+    _online = true;
+    _retry_wait_ms = I2C_HEALTH_RETRY_MIN_MS;
+    return;
+  }
+
+  if (_failures < 0xFF) {
+    _failures++;
+  }
+  if (_online) {
+    if (_failures < I2C_HEALTH_FAIL_LIMIT) {
+      return;
+    }
+    _online = false;
+    _dropouts++;
+  } else if (_retry_wait_ms < I2C_HEALTH_RETRY_MAX_MS) {
+    // A failed probe, back off further
+    _retry_wait_ms *= 2;
+    if (_retry_wait_ms > I2C_HEALTH_RETRY_MAX_MS) {
+      _retry_wait_ms = I2C_HEALTH_RETRY_MAX_MS;
+    }
+  }
+  _retry_at_ms = millis() + _retry_wait_ms;
+}
+
+bool I2CDeviceHealth::online() {
+  return _online;
+}
+
+uint8_t I2CDeviceHealth::failures() {
+  return _failures;
+}
+
+uint32_t I2CDeviceHealth::dropouts() {
+  return _dropouts;
+}
+
+void I2CDeviceHealth::skip() {
+  _skipped++;
+}
+
+uint32_t I2CDeviceHealth::skipped() {
+  return _skipped;
+}
+
+I2CBus::I2CBus() {
+  _i2c_interface = NULL;
+  _default_clock_hz = 100000;
+  _clock_hz = 0;
+  _device_count = 0;
+  _lock = portMUX_INITIALIZER_UNLOCKED;
+  _owner = NULL;
+  _nesting = 0;
+  _waiter_count = 0;
+  _requests = NULL;
+  resetStats();
+}
+
+void I2CBus::begin(TwoWire *i2c_interface, uint32_t default_clock_hz) {
+  _i2c_interface = i2c_interface;
+  _default_clock_hz = default_clock_hz;
+  _clock_hz = default_clock_hz;
+  _i2c_interface->setClock(default_clock_hz);
+}
+
+bool I2CBus::setDeviceClock(uint8_t address, uint32_t clock_hz) {
+  for (uint8_t i = 0; i < _device_count; i++) {
+    if (_devices[i].address == address) {
+      _devices[i].clock_hz = clock_hz;
+      return true;
+    }
+  }
+  if (_device_count >= I2C_BUS_MAX_DEVICES) {
+    return false;
+  }
+  _devices[_device_count].address = address;
+  _devices[_device_count].clock_hz = clock_hz;
+  _device_count++;
+  return true;
+}
+
+TwoWire *I2CBus::acquire(uint8_t address, uint8_t priority) {
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  uint32_t start_us = micros();
+  bool waited = false;
+
+  for (;;) {
+    portENTER_CRITICAL(&_lock);
+    if (_owner == self) {
+      // Nested transaction, or release() handed the bus to us
+      _nesting++;
+      portEXIT_CRITICAL(&_lock);
+      break;
+    }
+    if (_owner == NULL) {
+      _owner = self;
+      _nesting = 1;
+      portEXIT_CRITICAL(&_lock);
+      break;
+    }
+    bool queued = false;
+    for (uint8_t i = 0; i < _waiter_count; i++) {
+      queued |= _waiters[i].task == self;
+    }
+    if (queued) {
+      // Woken by an unrelated notification, keep waiting
+      portEXIT_CRITICAL(&_lock);
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      continue;
+    }
+    if (_waiter_count < I2C_BUS_MAX_WAITERS) {
+      // Behind every waiter of the same or higher priority
+      uint8_t slot = _waiter_count;
+      while (slot > 0 && _waiters[slot - 1].priority < priority) {
+        _waiters[slot] = _waiters[slot - 1];
+        slot--;
+      }
+      _waiters[slot].task = self;
+      _waiters[slot].priority = priority;
+      _waiter_count++;
+      if (_waiter_count > _stats.max_depth) {
+        _stats.max_depth = _waiter_count;
+      }
+      portEXIT_CRITICAL(&_lock);
+
+      waited = true;
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      continue;
+    }
+    portEXIT_CRITICAL(&_lock);
+
+    // More waiters than slots, try again shortly
+    waited = true;
+    vTaskDelay(1);
+  }
+
+  if (_nesting == 1) {
+    uint32_t wait_us = micros() - start_us;
+    _stats.transactions++;
+    if (waited) {
+      _stats.contended++;
+      _stats.total_wait_us += wait_us;
+      if (wait_us > _stats.max_wait_us) {
+        _stats.max_wait_us = wait_us;
+      }
+    }
+  }
+
+  uint32_t clock_hz = clockFor(address);
+  if (clock_hz != _clock_hz) {
+    _i2c_interface->setClock(clock_hz);
+    _clock_hz = clock_hz;
+    _stats.clock_changes++;
+  }
+  return _i2c_interface;
+}
+
+void I2CBus::release() {
+  TaskHandle_t next = NULL;
+
+  portENTER_CRITICAL(&_lock);
+  if (_nesting > 1) {
+    _nesting--;
+    portEXIT_CRITICAL(&_lock);
+    return;
+  }
+  if (_waiter_count > 0) {
+    // Hand over directly so no other task can slip in
+    next = _waiters[0].task;
+    for (uint8_t i = 1; i < _waiter_count; i++) {
+      _waiters[i - 1] = _waiters[i];
+    }
+    _waiter_count--;
+    // The new owner counts its own nesting from 0 in acquire()
+    _nesting = 0;
+  }
+  _owner = next;
+  portEXIT_CRITICAL(&_lock);
+
+  if (next != NULL) {
+    xTaskNotifyGive(next);
+  }
+}
+
+TwoWire *I2CBus::wire() {
+  return _i2c_interface;
+}
+
+uint8_t I2CBus::writeRead(uint8_t address,
+                          uint8_t reg,
+                          uint8_t *out,
+                          uint8_t length,
+                          uint8_t priority) {
+  TwoWire *i2c_interface = acquire(address, priority);
+  uint8_t received = i2cWriteRead(i2c_interface, address, reg, out, length);
+  release();
+  return received;
+}
+
+bool I2CBus::startWorker(uint8_t core, uint8_t task_priority) {
+  if (_requests != NULL) {
+    return true;
+  }
+  _requests = xQueueCreate(I2C_BUS_QUEUE_LENGTH, sizeof(I2CRequest *));
+  if (_requests == NULL) {
+    return false;
+  }
+  return xTaskCreatePinnedToCore(worker, "i2c", I2C_BUS_WORKER_STACK, this,
+                                 task_priority, NULL, core)
+         == pdPASS;
+}
+
+bool I2CBus::submit(I2CRequest *request) {
+  request->rx_received = 0;
+  if (request->health != NULL && !request->health->ready()) {
+    request->status = I2C_OFFLINE;
+    return false;
+  }
+  request->status = I2C_PENDING;
+  if (_requests == NULL || xQueueSend(_requests, &request, 0) != pdTRUE) {
+    request->status = I2C_QUEUE_FULL;
+    return false;
+  }
+  return true;
+}
+
+void I2CBus::execute(I2CRequest *request) {
+  if (request->health != NULL && !request->health->ready()) {
+    request->rx_received = 0;
+    request->status = I2C_OFFLINE;
+    if (request->callback != NULL) {
+      request->callback(request);
+    }
+    return;
+  }
+  transfer(request);
+}
+
+void I2CBus::transfer(I2CRequest *request) {
+  TwoWire *i2c_interface = acquire(request->address, request->priority);
+
+  uint8_t status = I2C_OK;
+  uint8_t received = 0;
+  if (request->tx_length > 0) {
+    i2c_interface->beginTransmission(request->address);
+    i2c_interface->write(request->tx, request->tx_length);
+    // Keep the bus if a read follows
+    if (i2c_interface->endTransmission(request->rx_length == 0) != 0) {
+      status = I2C_NACK;
+    }
+  }
+  if (status == I2C_OK && request->rx_length > 0) {
+    received = i2c_interface->requestFrom(request->address, request->rx_length);
+    for (uint8_t i = 0; i < received; i++) {
+      request->rx[i] = i2c_interface->read();
+    }
+    if (received < request->rx_length) {
+      status = received == 0 ? I2C_NACK : I2C_SHORT_READ;
+    }
+  }
+
+  release();
+
+  if (request->health != NULL) {
+    request->health->record(status == I2C_OK);
+  }
+  request->rx_received = received;
+  request->status = status;
+  if (request->callback != NULL) {
+    request->callback(request);
+  }
+}
+
+void I2CBus::worker(void *bus) {
+  I2CBus *self = (I2CBus *)bus;
+  I2CRequest *request;
+  for (;;) {
+    if (xQueueReceive(self->_requests, &request, portMAX_DELAY) == pdTRUE) {
+      // Offline devices were turned away by submit()
+      self->transfer(request);
+    }
+  }
+}
+
+uint8_t I2CBus::depth() {
+  return _waiter_count;
+}
+
+I2CBusStats I2CBus::stats() {
+  portENTER_CRITICAL(&_lock);
+  I2CBusStats copy = _stats;
+  portEXIT_CRITICAL(&_lock);
+  return copy;
+}
+
+void I2CBus::resetStats() {
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+uint32_t I2CBus::clockFor(uint8_t address) {
+  for (uint8_t i = 0; i < _device_count; i++) {
+    if (_devices[i].address == address) {
+      return _devices[i].clock_hz;
+    }
+  }
+  return _default_clock_hz;
+}
+
+I2CTransaction::I2CTransaction(I2CBus *bus, uint8_t address, uint8_t priority)
+  : _bus(bus) {
+  if (_bus != NULL) {
+    _bus->acquire(address, priority);
+  }
+}
+
+I2CTransaction::~I2CTransaction() {
+  if (_bus != NULL) {
+    _bus->release();
+  }
+}
@@ -1,23 +1,48 @@
-
 #include <Wire.h>
-#include "TCA9548A.h"
 // #include "TSYS01.h"
 #include "tsys01_2.h"
+#include "tca9548a_mux.h"
+#include "i2c_bus.h"
+#include "temp_filter.h"
+#include "sample_ring.h"
+#include "profile.h"
 
 
 #define MUX_ADDRESS 0x70
 
-#define TSYS01_ADDR 0x77
-#define TSYS01_RESET 0x1E
-#define TSYS01_ADC_READ 0x00
-#define TSYS01_ADC_TEMP_CONV 0x48
-#define TSYS01_PROM_READ 0XA0
+// Mux channel of each TSYS01, every one of them is on 0x77
+const uint8_t sensor_channels[] = { 0, 1 };
+const uint8_t sensor_count = sizeof(sensor_channels);
+
+struct SensorSlot {
+  TSYS01 tsys;
+  TempFilter filter;
+  // Filtered samples, at roughly 8 per second
+  SampleRing<128> history;
+  bool present;
+};
+
+// Mux and TSYS01s all support 400 kHz
+I2CBus i2c_bus;
+const uint32_t i2c_clock_hz = 400000;
 
-TCA9548A i2c_mux;
-TSYS01 tsys_1;
-TSYS01 tsys_2;
+TCA9548A_Mux i2c_mux;
+MuxSchedule schedule;
+SensorSlot sensors[sensor_count];
+uint8_t sensor_order[sensor_count];
 
-byte channels;
+// Start every sensor's conversion with one command through the mux
+// instead of converting them one at a time
+const bool broadcast_conversion = true;
+
+// Sensors missing at boot are looked for again this often
+const unsigned long probe_interval = 1000;
+unsigned long last_probe_time = 0;
+
+// Sample as fast as the sensors convert, report once a second
+const unsigned long report_interval = 1000;
+unsigned long last_report_time = 0;
+uint32_t last_cycle_us = 0;
 
 enum PinNumbers {
   I2C_SDA = 21,
@@ -31,83 +56,174 @@ enum PinNumbers {
   INTERRUPT_PIN = 14,
 };
 
-// libs
-void select_channel(int channel) {
-  Wire.beginTransmission(MUX_ADDRESS);
-  Wire.write(1 << channel);
-  Wire.endTransmission();
-}
+void setup() {
+  Serial.begin(115200);
+  Wire.begin(I2C_SDA, I2C_SCL);
 
-void tca_write(uint8_t data) {
-  Wire.beginTransmission(MUX_ADDRESS);
-  Wire.write(data);
-  Wire.endTransmission(true);
-}
+  i2c_bus.begin(&Wire);
+  i2c_bus.setDeviceClock(MUX_ADDRESS, i2c_clock_hz);
+  i2c_bus.setDeviceClock(0x77, i2c_clock_hz);
+  i2c_mux.begin(&i2c_bus, MUX_ADDRESS);
+
+  for (uint8_t i = 0; i < sensor_count; i++) {
+    schedule.add(sensor_channels[i]);
 
-void open_channel(byte channel) {
-  // uint8_t buff = 0x00;
-  // buff = 1 << channel;
-  // channels |= buff;
-  channels |= (1 << channel);
+    sensors[i].tsys.setBus(&i2c_bus);
+    if (!probe(i)) {
+      Serial.printf("TSYS01 not found on channel %d!\n", sensor_channels[i]);
+    }
+    sensors[i].tsys.setAdaptive(true);
 
-  Wire.beginTransmission(MUX_ADDRESS);
-  Wire.write(channels);
-  Wire.endTransmission(true);
+    // Average 8 conversions, reject spikes over 3 outputs, alpha = 1/4
+    sensors[i].filter.configure(8, 3, 2);
+  }
 }
 
-void setup() {
-  Serial.begin(115200);
-  Wire.begin(I2C_SDA, I2C_SCL);
+/*
+  Looks for a sensor that has not been calibrated yet. A missing sensor
+  costs one NACKed reset.
+*/
+bool probe(uint8_t i) {
+  MuxChannelGuard guard(i2c_mux, sensor_channels[i]);
+  sensors[i].present = guard.ok() && sensors[i].tsys.init();
+  return sensors[i].present;
+}
+
+void store_sample(uint8_t i) {
+  if (sensors[i].filter.push((int32_t)(sensors[i].tsys.temperature() * 1000.0f))) {
+    sensors[i].history.push(millis(), sensors[i].filter.value());
+  }
+}
 
-  // i2c_mux.begin(Wire);
-  // i2c_mux.closeAll();
+/*
+  Converts and reads one sensor at a time, about 10 ms per sensor.
+*/
+void acquire_sequential() {
+  // Visit the sensors channel by channel, starting where the mux is
+  schedule.plan(i2c_mux.activeMask(), sensor_order);
+  for (uint8_t n = 0; n < sensor_count; n++) {
+    uint8_t i = sensor_order[n];
+    if (!sensors[i].present) {
+      continue;
+    }
+
+    MuxChannelGuard guard(i2c_mux, schedule.channel(i));
+    if (!guard.ok()) {
+      continue;
+    }
+
+    if (sensors[i].tsys.read()) {
+      store_sample(i);
+    }
+  }
+}
 
-  // i2c_mux.openChannel(0);
-  // select_channel(0);
-  // tsys_1.init();
+/*
+  Opens every sensor channel at once so a single conversion command
+  reaches all of them, then reads each ADC in turn. A cycle takes one
+  conversion time plus a short read per sensor. Conversion stats are
+  only gathered on the sensor that sent the command.
+*/
+void acquire_broadcast() {
+  uint8_t mask = 0;
+  for (uint8_t i = 0; i < sensor_count; i++) {
+    if (sensors[i].present) {
+      mask |= (1 << schedule.channel(i));
+    }
+  }
+  // Hold the bus for the whole cycle so nothing changes the mux mask
+  I2CTransaction cycle(&i2c_bus, MUX_ADDRESS);
+  if (mask == 0 || !i2c_mux.select(mask)) {
+    return;
+  }
 
-  if (!tsys_1.init()) {
-    Serial.println("TSYS01 not found!");
+  // All TSYS01s share 0x77, so any of them can send the command. The
+  // first one whose health lets it through does, and only that one waits
+  // out the conversion and learns its time.
+  int8_t first = -1;
+  for (uint8_t i = 0; i < sensor_count && first < 0; i++) {
+    if (sensors[i].present && sensors[i].tsys.startConversion()) {
+      first = i;
+    }
   }
-  
-  Wire.beginTransmission(TSYS01_ADDR);
-  Wire.write(TSYS01_RESET);
-  Wire.endTransmission();
-
-  delay(10);
-  int received_bytes = 0;
-  // Read calibration values
-  for (uint8_t i = 0; i < 8; i++) {
-    Wire.beginTransmission(TSYS01_ADDR);
-    Wire.write(TSYS01_PROM_READ + i * 2);
-    Wire.endTransmission();
-
-    received_bytes += Wire.requestFrom(TSYS01_ADDR, 2);
-    C[i] = (Wire.read() << 8) | Wire.read();
+  if (first < 0) {
+    return;
+  }
+  {
+    MuxChannelGuard guard(i2c_mux, schedule.channel(first));
+    if (!guard.ok()) {
+      return;
+    }
+    if (sensors[first].tsys.fetch()) {
+      store_sample(first);
+    }
   }
 
-  // i2c_mux.openChannel(1);
-  // select_channel(1);
-  // tsys_2.init();
+  // The rest converted alongside it, so their results are ready now
+  schedule.plan(i2c_mux.activeMask(), sensor_order);
+  for (uint8_t n = 0; n < sensor_count; n++) {
+    uint8_t i = sensor_order[n];
+    if (!sensors[i].present || i == first) {
+      continue;
+    }
+
+    MuxChannelGuard guard(i2c_mux, schedule.channel(i));
+    if (!guard.ok()) {
+      continue;
+    }
+
+    if (sensors[i].tsys.fetchResult()) {
+      store_sample(i);
+    }
+  }
 }
 
 void loop() {
 
-  // i2c_mux.openChannel(0);
-  // open_channel(0);
-  // select_channel(0);
-  tsys_1.read();
-
-  // i2c_mux.openChannel(1);
-  // open_channel(1);
-  // select_channel(1);
-  // tsys_2.read();
+  uint32_t cycle_start = micros();
+  if (broadcast_conversion) {
+    acquire_broadcast();
+  } else {
+    acquire_sequential();
+  }
+  last_cycle_us = micros() - cycle_start;
+
+  if (millis() - last_probe_time >= probe_interval) {
+    last_probe_time = millis();
+    for (uint8_t i = 0; i < sensor_count; i++) {
+      if (!sensors[i].present && probe(i)) {
+        Serial.printf("TSYS01 found on channel %d\n", sensor_channels[i]);
+      }
+    }
+  }
 
-  float temp_1 = tsys_1.temperature();
-  // float temp_2 = tsys_2.temperature();
+  if (millis() - last_report_time < report_interval) {
+    return;
+  }
+  last_report_time = millis();
+
+  for (uint8_t i = 0; i < sensor_count; i++) {
+    if (sensors[i].present && !sensors[i].tsys.online()) {
+      Serial.printf("T%d: offline, %u readings skipped\n", i, sensors[i].tsys.skipped());
+      continue;
+    }
+    SampleStats stats;
+    if (!sensors[i].history.snapshot(stats)) {
+      continue;
+    }
+    Serial.printf("T%d: %.2f  min %.2f max %.2f mean %.3f\n",
+                  i, sensors[i].filter.value() / 1000.0f,
+                  stats.min / 1000.0f, stats.max / 1000.0f, stats.mean / 1000.0f);
+  }
+  Serial.printf("CYCLE us: %u\n", last_cycle_us);
+  Serial.printf("MUX writes %u skipped %u\n", i2c_mux.writes(), i2c_mux.skippedWrites());
 
-  Serial.printf("T: %.2f\n", temp_1);
-  // Serial.printf("T: %.2f  %.2f\n", temp_1, temp_2);
+  I2CBusStats bus = i2c_bus.stats();
+  Serial.printf("I2C transactions %u waited %u (max %u us, max depth %u) clock changes %u\n",
+                bus.transactions, bus.contended, bus.max_wait_us, bus.max_depth, bus.clock_changes);
 
-  delay(1000);
+  // Send 'p' to dump the timing histograms
+  if (Serial.read() == 'p') {
+    PROFILE_DUMP(Serial);
+  }
 }
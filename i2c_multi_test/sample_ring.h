@@ -0,0 +1,211 @@
+/*
+  Fixed-memory ring buffer of timestamped samples with streaming
+  statistics over the buffered window.
+
+  min/max/mean/variance are kept up to date on every push in O(1)
+  (amortized for min/max), so consumers never need to walk the history.
+  Mean and variance use Welford's algorithm, with the inverse update
+  applied when the oldest sample falls out of the window.
+
+  One writer may push while any number of readers take snapshots. A
+  sequence counter lets readers detect a concurrent write and retry,
+  so the writer never blocks and nothing is allocated.
+*/
+
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+#include "Arduino.h"
+#include <atomic>
+
+struct Sample {
+  uint32_t timestamp_ms;
+  int32_t value;
+};
+
+struct SampleStats {
+  uint16_t count;
+  int32_t min;
+  int32_t max;
+  float mean;
+  float variance;
+  Sample latest;
+};
+
+template<uint16_t N>
+class SampleRing {
+  static_assert(N >= 2, "SampleRing needs room for at least two samples");
+
+public:
+  SampleRing() {
+    clear();
+  }
+
+  /**
+   * @brief Drops all samples. Must only be called by the writer.
+   */
+  void clear() {
+    beginWrite();
+    _pushed = 0;
+    _count = 0;
+    _mean = 0;
+    _m2 = 0;
+    _min_head = _min_count = 0;
+    _max_head = _max_count = 0;
+    endWrite();
+  }
+
+  /**
+   * @brief Appends a sample, evicting the oldest one when full.
+   *        Must only be called by the writer.
+   */
+  void push(uint32_t timestamp_ms, int32_t value) {
+    beginWrite();
+
+    uint32_t seq = _pushed;
+    Sample& slot = _samples[seq % N];
+
+    if (_count == N) {
+      // Inverse Welford update for the sample leaving the window
+      double old_value = slot.value;
+      double delta = old_value - _mean;
+      _mean -= delta / (_count - 1);
+      _m2 -= delta * (old_value - _mean);
+      _count--;
+
+      // Drop extremes that belonged to the evicted sample
+      uint32_t oldest = seq - N;
+      if (_min_count > 0 && _min_index[_min_head] == oldest) {
+        _min_head = (_min_head + 1) % N;
+        _min_count--;
+      }
+      if (_max_count > 0 && _max_index[_max_head] == oldest) {
+        _max_head = (_max_head + 1) % N;
+        _max_count--;
+      }
+    }
+
+    slot.timestamp_ms = timestamp_ms;
+    slot.value = value;
+
+    _count++;
+    double delta = value - _mean;
+    _mean += delta / _count;
+    _m2 += delta * (value - _mean);
+    if (_m2 < 0) {
+      // Rounding from the inverse updates can leave a tiny negative value
+      _m2 = 0;
+    }
+
+    // Monotonic queues: the front always holds the window min/max
+    while (_min_count > 0 && valueAt(_min_index[(_min_head + _min_count - 1) % N]) >= value) {
+      _min_count--;
+    }
+    _min_index[(_min_head + _min_count) % N] = seq;
+    _min_count++;
+
+    while (_max_count > 0 && valueAt(_max_index[(_max_head + _max_count - 1) % N]) <= value) {
+      _max_count--;
+    }
+    _max_index[(_max_head + _max_count) % N] = seq;
+    _max_count++;
+
+    _pushed = seq + 1;
+
+    endWrite();
+  }
+
+  /**
+   * @brief Takes a consistent copy of the window statistics.
+   *
+   * @return false if the window is empty or the writer kept
+   *         interrupting the read.
+   */
+  bool snapshot(SampleStats& out) const {
+    for (uint8_t attempt = 0; attempt < _kMaxReadAttempts; attempt++) {
+      uint32_t start = _sequence.load(std::memory_order_acquire);
+      if (start & 1) {
+        continue;
+      }
+
+      out.count = _count;
+      if (_count > 0) {
+        out.min = valueAt(_min_index[_min_head]);
+        out.max = valueAt(_max_index[_max_head]);
+        out.mean = _mean;
+        out.variance = _count > 1 ? _m2 / (_count - 1) : 0;
+        out.latest = _samples[(_pushed - 1) % N];
+      }
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (_sequence.load(std::memory_order_relaxed) == start) {
+        return out.count > 0;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * @brief Copies up to max_samples of the most recent samples,
+   *        oldest first.
+   *
+   * @return The number of samples copied, 0 if the writer kept
+   *         interrupting the read.
+   */
+  uint16_t copyRecent(Sample* out, uint16_t max_samples) const {
+    for (uint8_t attempt = 0; attempt < _kMaxReadAttempts; attempt++) {
+      uint32_t start = _sequence.load(std::memory_order_acquire);
+      if (start & 1) {
+        continue;
+      }
+
+      uint16_t copied = _count < max_samples ? _count : max_samples;
+      uint32_t first = _pushed - copied;
+      for (uint16_t i = 0; i < copied; i++) {
+        out[i] = _samples[(first + i) % N];
+      }
+
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (_sequence.load(std::memory_order_relaxed) == start) {
+        return copied;
+      }
+    }
+    return 0;
+  }
+
+private:
+  static const uint8_t _kMaxReadAttempts = 8;
+
+  Sample _samples[N];
+  uint32_t _pushed;
+  uint16_t _count;
+
+  double _mean;
+  double _m2;
+
+  // Sample sequence numbers, oldest first
+  uint32_t _min_index[N];
+  uint16_t _min_head;
+  uint16_t _min_count;
+  uint32_t _max_index[N];
+  uint16_t _max_head;
+  uint16_t _max_count;
+
+  // Odd while the writer is updating
+  std::atomic<uint32_t> _sequence{ 0 };
+
+  int32_t valueAt(uint32_t seq) const {
+    return _samples[seq % N].value;
+  }
+
+  void beginWrite() {
+    _sequence.store(_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  void endWrite() {
+    _sequence.store(_sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+};
+
+#endif
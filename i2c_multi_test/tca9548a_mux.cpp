@@ -0,0 +1,136 @@
+#include "tca9548a_mux.h"
+
+TCA9548A_Mux::TCA9548A_Mux() {
+  _bus = NULL;
+  _i2c_interface = NULL;
+  _i2c_address = 0;
+  _active_mask = 0;
+  _mask_valid = false;
+  _writes = 0;
+  _skipped_writes = 0;
+}
+
+void TCA9548A_Mux::begin(TwoWire *i2c_interface, uint8_t i2c_address) {
+  _i2c_interface = i2c_interface;
+  _i2c_address = i2c_address;
+
+  // The mux state is unknown after boot, so force the first write
+  invalidate();
+  closeAll();
+}
+
+void TCA9548A_Mux::begin(I2CBus *bus, uint8_t i2c_address) {
+  _bus = bus;
+  begin(bus->wire(), i2c_address);
+}
+
+bool TCA9548A_Mux::select(uint8_t mask) {
+  if (_mask_valid && mask == _active_mask) {
+    _skipped_writes++;
+    return true;
+  }
+
+  I2CTransaction transaction(_bus, _i2c_address);
+  _i2c_interface->beginTransmission(_i2c_address);
+  _i2c_interface->write(mask);
+  _writes++;
+  if (_i2c_interface->endTransmission() != 0) {
+    invalidate();
+    return false;
+  }
+
+  _active_mask = mask;
+  _mask_valid = true;
+  return true;
+}
+
+bool TCA9548A_Mux::selectChannel(uint8_t channel) {
+  return select(1 << channel);
+}
+
+bool TCA9548A_Mux::openChannel(uint8_t channel) {
+  return select(_active_mask | (1 << channel));
+}
+
+bool TCA9548A_Mux::closeChannel(uint8_t channel) {
+  return select(_active_mask & ~(1 << channel));
+}
+
+bool TCA9548A_Mux::closeAll() {
+  return select(0x00);
+}
+
+void TCA9548A_Mux::invalidate() {
+  _mask_valid = false;
+}
+
+uint8_t TCA9548A_Mux::activeMask() {
+  return _active_mask;
+}
+
+uint32_t TCA9548A_Mux::writes() {
+  return _writes;
+}
+
+uint32_t TCA9548A_Mux::skippedWrites() {
+  return _skipped_writes;
+}
+
+I2CBus *TCA9548A_Mux::bus() {
+  return _bus;
+}
+
+uint8_t TCA9548A_Mux::address() {
+  return _i2c_address;
+}
+
+MuxChannelGuard::MuxChannelGuard(TCA9548A_Mux &mux, uint8_t channel)
+  : _transaction(mux.bus(), mux.address()) {
+  _ok = mux.selectChannel(channel);
+}
+
+bool MuxChannelGuard::ok() {
+  return _ok;
+}
+
+MuxSchedule::MuxSchedule() {
+  _count = 0;
+}
+
+int8_t MuxSchedule::add(uint8_t channel) {
+  if (_count >= TCA9548A_MAX_SLOTS || channel >= TCA9548A_CHANNELS) {
+    return -1;
+  }
+  _channels[_count] = channel;
+  return _count++;
+}
+
+void MuxSchedule::plan(uint8_t active_mask, uint8_t order[]) {
+  // Start on the selected channel if exactly one is open
+  uint8_t first_channel = 0;
+  if (active_mask != 0 && (active_mask & (active_mask - 1)) == 0) {
+    while (!(active_mask & (1 << first_channel))) {
+      first_channel++;
+    }
+  }
+
+  // Walk the channels once, starting at first_channel, emitting every
+  // slot on each channel together
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < TCA9548A_CHANNELS; i++) {
+    uint8_t channel = (first_channel + i) % TCA9548A_CHANNELS;
+    for (uint8_t slot = 0; slot < _count; slot++) {
+      if (_channels[slot] == channel) {
+        order[n++] = slot;
+      }
+    }
+  }
+}
+
+uint8_t MuxSchedule::count() {
+  return _count;
+}
+
+uint8_t MuxSchedule::channel(uint8_t slot) {
+  return _channels[slot];
+}
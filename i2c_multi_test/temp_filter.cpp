@@ -0,0 +1,95 @@
+#include "temp_filter.h"
+
+TempFilter::TempFilter() {
+  configure(1, 1, 0);
+}
+
+void TempFilter::configure(uint8_t oversample, uint8_t median, uint8_t iir_shift) {
+  _oversample = oversample > 0 ? oversample : 1;
+
+  // Median window must be odd and fit in the preallocated buffer
+  if (median > TEMP_FILTER_MAX_MEDIAN) {
+    median = TEMP_FILTER_MAX_MEDIAN;
+  }
+  if (median % 2 == 0) {
+    median = median > 0 ? median - 1 : 1;
+  }
+  _median = median;
+
+  // Keep (sample << frac bits) from overflowing the IIR state
+  _iir_shift = iir_shift > 15 ? 15 : iir_shift;
+
+  reset();
+}
+
+void TempFilter::reset() {
+  _oversample_sum = 0;
+  _oversample_count = 0;
+  _window_index = 0;
+  _window_fill = 0;
+  _iir_state = 0;
+  _iir_primed = false;
+  _value = 0;
+}
+
+bool TempFilter::push(int32_t sample) {
+  _oversample_sum += sample;
+  _oversample_count++;
+  if (_oversample_count < _oversample) {
+    return false;
+  }
+
+  int32_t averaged = _oversample_sum / _oversample;
+  _oversample_sum = 0;
+  _oversample_count = 0;
+
+  _value = iir(median(averaged));
+  return true;
+}
+
+int32_t TempFilter::value() {
+  return _value;
+}
+
+int32_t TempFilter::median(int32_t sample) {
+  if (_median <= 1) {
+    return sample;
+  }
+
+  _window[_window_index] = sample;
+  _window_index = (_window_index + 1) % _median;
+  if (_window_fill < _median) {
+    _window_fill++;
+  }
+
+  // Insertion sort a copy, the window is at most a handful of samples
+  int32_t sorted[TEMP_FILTER_MAX_MEDIAN];
+  for (uint8_t i = 0; i < _window_fill; i++) {
+    int32_t v = _window[i];
+    uint8_t j = i;
+    while (j > 0 && sorted[j - 1] > v) {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+    sorted[j] = v;
+  }
+  return sorted[_window_fill / 2];
+}
+
+int32_t TempFilter::iir(int32_t sample) {
+  if (_iir_shift == 0) {
+    return sample;
+  }
+
+  int32_t scaled = sample * (1L << _kIirFracBits);
+  if (!_iir_primed) {
+    // Start from the first sample instead of ramping up from 0
+    _iir_state = scaled;
+    _iir_primed = true;
+  } else {
+    _iir_state += (scaled - _iir_state) >> _iir_shift;
+  }
+
+  // Round to nearest when dropping the fractional bits
+  return (_iir_state + (1L << (_kIirFracBits - 1))) >> _kIirFracBits;
+}
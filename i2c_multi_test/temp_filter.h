@@ -0,0 +1,79 @@
+/*
+  Integer filter pipeline for temperature streams.
+
+  Raw samples go through three optional stages, in order:
+    1. Oversampling: N samples are averaged into one.
+    2. Median-of-k: rejects single-sample spikes.
+    3. First order IIR: y += (x - y) / 2^shift.
+
+  Samples are in milli-degrees C. All state is preallocated and only
+  integer math is used, so push() is cheap enough to call at the sensor's
+  maximum conversion rate.
+*/
+
+#ifndef TEMP_FILTER_H
+#define TEMP_FILTER_H
+
+#include "Arduino.h"
+
+// Largest median window supported
+#define TEMP_FILTER_MAX_MEDIAN 7
+
+class TempFilter {
+public:
+  TempFilter();
+
+  /**
+   * @brief Configures the filter stages and resets the filter state.
+   *
+   * @param oversample Samples averaged per output. 1 disables the stage.
+   * @param median Median window size, odd and up to TEMP_FILTER_MAX_MEDIAN.
+   *               1 disables the stage.
+   * @param iir_shift IIR smoothing factor, alpha = 1 / 2^iir_shift.
+   *                  0 disables the stage.
+   */
+  void configure(uint8_t oversample, uint8_t median, uint8_t iir_shift);
+
+  /**
+   * @brief Clears all samples, keeping the configuration.
+   */
+  void reset();
+
+  /**
+   * @brief Pushes a raw sample through the pipeline.
+   *
+   * @param sample Temperature in milli-degrees C.
+   * @return true when a new filtered value is ready.
+   */
+  bool push(int32_t sample);
+
+  /**
+   * @brief Latest filtered temperature in milli-degrees C.
+   */
+  int32_t value();
+
+private:
+  // Fractional bits kept in the IIR state to avoid truncation drift
+  static const uint8_t _kIirFracBits = 8;
+
+  uint8_t _oversample;
+  uint8_t _median;
+  uint8_t _iir_shift;
+
+  int32_t _oversample_sum;
+  uint8_t _oversample_count;
+
+  int32_t _window[TEMP_FILTER_MAX_MEDIAN];
+  uint8_t _window_index;
+  uint8_t _window_fill;
+
+  int32_t _iir_state;
+  bool _iir_primed;
+
+  int32_t _value;
+
+  int32_t median(int32_t sample);
+  int32_t iir(int32_t sample);
+};
+
+#endif
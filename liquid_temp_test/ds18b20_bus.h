@@ -0,0 +1,177 @@
+/*
+  Non-blocking DS18B20 acquisition on one OneWire bus.
+
+  A single Skip ROM "convert T" starts a conversion on every sensor at
+  once. poll() then returns immediately until the conversion is done and
+  reads one scratchpad per call, so the caller never sits in a 750 ms
+  blocking read.
+
+  ROM IDs are enumerated once and kept in NVS, so later boots skip the
+  OneWire search. Sensors are addressed directly by ROM, and the bus is
+  only searched again when a sensor stops answering.
+
+  Conversion time depends on resolution:
+     9 bit: 0.5    C,  93.75 ms
+    10 bit: 0.25   C, 187.5  ms
+    11 bit: 0.125  C, 375    ms
+    12 bit: 0.0625 C, 750    ms
+*/
+
+#ifndef DS18B20_BUS_H
+#define DS18B20_BUS_H
+
+#include "Arduino.h"
+#include <OneWire.h>
+#include <Preferences.h>
+
+#define DS18B20_MAX_DEVICES 8
+// Consecutive failed reads of one sensor before the bus is searched again
+#define DS18B20_RESCAN_AFTER_FAILURES 3
+
+enum DS18B20_Resolution {
+  DS18B20_RESOLUTION_9_BIT = 9,
+  DS18B20_RESOLUTION_10_BIT = 10,
+  DS18B20_RESOLUTION_11_BIT = 11,
+  DS18B20_RESOLUTION_12_BIT = 12,
+};
+
+class DS18B20_Bus {
+public:
+  DS18B20_Bus();
+
+  /**
+   * @brief Loads the saved sensor ROMs, or searches the bus if there are
+   *        none, and sets the sensors' resolution.
+   *
+   * @param one_wire OneWire bus the sensors are on
+   * @param resolution Resolution for every sensor on the bus
+   * @param nvs_namespace NVS namespace the ROMs are saved under,
+   *                      one per bus
+   * @return The number of sensors found.
+   */
+  uint8_t begin(OneWire *one_wire,
+                DS18B20_Resolution resolution,
+                const char *nvs_namespace = "ds18b20");
+
+  /**
+   * @brief Searches the bus and saves the ROMs found.
+   *        Must not be called while a conversion is running.
+   *
+   * @return The number of sensors found.
+   */
+  uint8_t rescan();
+
+  /**
+   * @brief Sets the resolution of every known sensor and copies it to
+   *        its EEPROM, so it survives a power cycle. Sensors already at
+   *        this resolution are only read, not written, which spares
+   *        their EEPROM on every boot and rescan. Blocks for the 10 ms
+   *        EEPROM write of each sensor that changes. Must not be called
+   *        while a conversion is running.
+   * @return false if a sensor that needed the change did not answer.
+   */
+  bool setResolution(DS18B20_Resolution resolution);
+
+  /**
+   * @brief Worst-case conversion time at the current resolution.
+   */
+  uint32_t conversionTimeMs();
+
+  /**
+   * @brief Starts a conversion on every sensor with one command.
+   *
+   * @return false if a conversion is already running
+   *         or no sensor answered the reset.
+   */
+  bool startConversion();
+
+  /**
+   * @brief Advances the acquisition. Call often, it never blocks for
+   *        longer than one scratchpad read.
+   *
+   * @return true once per conversion, when every sensor has been read.
+   */
+  bool poll();
+
+  /**
+   * @brief true from startConversion() until poll() has read every sensor.
+   */
+  bool busy();
+
+  uint8_t deviceCount();
+
+  /**
+   * @brief Last temperature of a sensor in milli-degrees C.
+   */
+  int32_t temperatureMilli(uint8_t index);
+
+  /**
+   * @brief false if the last read of this sensor failed its CRC check.
+   */
+  bool valid(uint8_t index);
+
+  /**
+   * @brief ROM ID of a sensor, 8 bytes with the family code first.
+   */
+  const uint8_t *rom(uint8_t index);
+
+  /**
+   * @brief Number of bus searches since begin(), including the first one
+   *        if the ROMs were not saved yet.
+   */
+  uint32_t scanCount();
+
+private:
+  enum State {
+    IDLE,
+    CONVERTING,
+    READING,
+  };
+
+  enum Commands {
+    CONVERT_T = 0x44,
+    WRITE_SCRATCHPAD = 0x4E,
+    COPY_SCRATCHPAD = 0x48,
+    READ_SCRATCHPAD = 0xBE,
+    READ_POWER_SUPPLY = 0xB4,
+  };
+
+  static const uint8_t _kScratchpadSize = 9;
+  static const uint8_t _kConfigIndex = 4;
+  static const uint8_t _kFamilyCode = 0x28;
+  static const uint8_t _kRomSize = 8;
+  // EEPROM write time of Copy Scratchpad, per datasheet
+  static const uint8_t _kCopyTimeMs = 10;
+
+  OneWire *_one_wire;
+  const char *_nvs_namespace;
+  DS18B20_Resolution _resolution;
+  // Parasite powered sensors can't signal completion, so wait it out
+  bool _parasite;
+
+  State _state;
+  uint32_t _conv_start_ms;
+  uint8_t _read_index;
+
+  uint8_t _roms[DS18B20_MAX_DEVICES][_kRomSize];
+  uint8_t _count;
+  bool _rescan_pending;
+  uint32_t _scan_count;
+
+  int32_t _temperatures[DS18B20_MAX_DEVICES];
+  bool _valid[DS18B20_MAX_DEVICES];
+  uint8_t _failures[DS18B20_MAX_DEVICES];
+
+  bool romValid(const uint8_t *rom);
+  bool loadRoms();
+  void saveRoms();
+  void resetReadings();
+
+  bool conversionDone();
+  bool writeConfig(uint8_t index, uint8_t config);
+  // false if the sensor is absent, or the read failed its CRC or was all zeros
+  bool fetchScratchpad(uint8_t index, uint8_t *scratchpad);
+  void readScratchpad(uint8_t index);
+};
+
+#endif
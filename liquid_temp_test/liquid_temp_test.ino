@@ -1,20 +1,47 @@
-// #include <DS18B20.h>
-// DS18B20 ds(15);
+#include <OneWire.h>
+#include "ds18b20_bus.h"
 
 #include <SoftwareSerial.h>
 
 SoftwareSerial uart1(2, 3); // RX, TX
 
+OneWire one_wire(15);
+DS18B20_Bus ds;
+
+// 9 bit (0.5 C) converts in under 100 ms, 12 bit (0.0625 C) takes 750 ms
+const DS18B20_Resolution resolution = DS18B20_RESOLUTION_10_BIT;
+
+// Start a new conversion at most this often
+const unsigned long sample_interval = 250;
+unsigned long last_sample_time = 0;
+
 void setup() {
   // put your setup code here, to run once:
 
   Serial.begin(9600);
+
+  uint8_t found = ds.begin(&one_wire, resolution);
+  Serial.printf("DS18B20 found: %d (%s), conversion %u ms\n",
+                found, ds.scanCount() > 0 ? "searched" : "saved", ds.conversionTimeMs());
 }
 
 void loop() {
   // put your main code here, to run repeatedly:
 
-  // Serial.println(ds.getTempC());
-  printf("TEMP: %f\n", ds.getTempC());
-  delay(250);
+  if (!ds.busy() && millis() - last_sample_time >= sample_interval) {
+    last_sample_time = millis();
+    ds.startConversion();
+  }
+
+  if (ds.poll()) {
+    for (uint8_t i = 0; i < ds.deviceCount(); i++) {
+      if (ds.valid(i)) {
+        Serial.printf("TEMP %d: %.3f\n", i, ds.temperatureMilli(i) / 1000.0f);
+      } else {
+        Serial.printf("TEMP %d: CRC ERROR\n", i);
+      }
+    }
+  }
+
+  // Other work runs here while the sensors convert
 }
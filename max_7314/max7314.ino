@@ -1,5 +1,6 @@
 #include <Wire.h>
-#include "src/MAX7314/max7314.h"
+#include "src/max7314.h"
+#include "src/DeferredLog.hpp"
 
 // For controlling GPIO
 MAX7314 expanderOne;
@@ -42,4 +43,5 @@ void setup() {
 
 void loop() {
   // put your main code here, to run repeatedly:
+  Log.drain(Serial);
 }
@@ -0,0 +1,105 @@
+#include "DeferredLog.hpp"
+
+DeferredLog Log;
+
+DeferredLog::DeferredLog()
+  : _head(0), _tail(0), _dropped(0) {}
+
+bool DeferredLog::log(const char *format,
+                      uint32_t arg0,
+                      uint32_t arg1,
+                      uint32_t arg2,
+                      uint32_t arg3) {
+  Record *record = claim();
+  if (record == NULL) {
+    return false;
+  }
+  record->format = format;
+  record->kind = FORMAT;
+  record->args[0] = arg0;
+  record->args[1] = arg1;
+  record->args[2] = arg2;
+  record->args[3] = arg3;
+  publish();
+  return true;
+}
+
+bool DeferredLog::logBytes(const char *label, const uint8_t *data, uint16_t length) {
+  do {
+    Record *record = claim();
+    if (record == NULL) {
+      return false;
+    }
+    uint8_t chunk = length < DEFERRED_LOG_BYTES ? length : DEFERRED_LOG_BYTES;
+    record->format = label;
+    record->kind = BYTES;
+    record->length = chunk;
+    memcpy(record->bytes, data, chunk);
+    publish();
+
+    data += chunk;
+    length -= chunk;
+  } while (length > 0);
+  return true;
+}
+
+uint8_t DeferredLog::drain(HardwareSerial &out, uint8_t max_records) {
+  char line[_kLineSize];
+  uint8_t sent = 0;
+
+  while (sent < max_records) {
+    uint16_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire)) {
+      break;
+    }
+
+    uint8_t length = format(_records[tail], line);
+    if (out.availableForWrite() < length) {
+      // Leave it queued rather than wait on the UART
+      break;
+    }
+    out.write((const uint8_t *)line, length);
+
+    _tail.store((tail + 1) % DEFERRED_LOG_RECORDS, std::memory_order_release);
+    sent++;
+  }
+  return sent;
+}
+
+uint32_t DeferredLog::dropped() {
+  return _dropped.load(std::memory_order_relaxed);
+}
+
+DeferredLog::Record *DeferredLog::claim() {
+  uint16_t head = _head.load(std::memory_order_relaxed);
+  uint16_t next = (head + 1) % DEFERRED_LOG_RECORDS;
+  if (next == _tail.load(std::memory_order_acquire)) {
+    _dropped.fetch_add(1, std::memory_order_relaxed);
+    return NULL;
+  }
+  return &_records[head];
+}
+
+void DeferredLog::publish() {
+  uint16_t head = _head.load(std::memory_order_relaxed);
+  _head.store((head + 1) % DEFERRED_LOG_RECORDS, std::memory_order_release);
+}
+
+uint8_t DeferredLog::format(const Record &record, char *line) {
+  int length;
+  if (record.kind == FORMAT) {
+    length = snprintf(line, _kLineSize, record.format,
+                      record.args[0], record.args[1], record.args[2], record.args[3]);
+  } else {
+    length = snprintf(line, _kLineSize, "%s", record.format);
+    for (uint8_t i = 0; i < record.length && length < _kLineSize - 4; i++) {
+      length += snprintf(line + length, _kLineSize - length, "%02X ", record.bytes[i]);
+    }
+    length += snprintf(line + length, _kLineSize - length, "\n");
+  }
+
+  if (length < 0) {
+    return 0;
+  }
+  return length < _kLineSize ? length : _kLineSize - 1;
+}
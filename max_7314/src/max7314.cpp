@@ -4,6 +4,9 @@
 
 #include "Arduino.h"
 #include "max7314.h"
+#include "DeferredLog.hpp"
+#include "LogLevel.hpp"
+#include "I2CBus.hpp"
 
 // The GPIO Expander auto-increments registers, so for any _REG_0 register,
 // we don't need to define any others
@@ -69,8 +72,7 @@ void MAX7314::init(
 
   // Set up GPIO callback
   if (callback != NULL) {
-    // Serial.print("Initializing interupt on GPIO: ");
-    // Serial.println(pin);
+    LOG_DEFERRED(DRIVER, INFO, "Initializing interrupt on GPIO: %u\n", pin);
     attachInterrupt(digitalPinToInterrupt(pin), callback, FALLING);
   }
 }
@@ -89,10 +91,7 @@ void MAX7314::configureInputs(MAX7314_StaticPins inputBitfield) {
   // int val1 = _configs[0];
   // int val2 = _configs[1];
 
-  Serial.print("PINS 0-7: ");
-  Serial.println(_configs[0], BIN);
-  Serial.print("PINS 8-15: ");
-  Serial.println(_configs[1], BIN);
+  LOG_DEFERRED(DRIVER, DEBUG, "PINS 0-7: %02X PINS 8-15: %02X\n", _configs[0], _configs[1]);
 
   // Send them to the expander.
   _i2c_interface->beginTransmission(_i2c_address);
@@ -116,10 +115,7 @@ void MAX7314::configureOutputs(MAX7314_StaticPins outputBitfield) {
   // int val1 = _configs[0];
   // int val2 = _configs[1];
 
-  Serial.print("PINS 0-7: ");
-  Serial.println(_configs[0], BIN);
-  Serial.print("PINS 8-15: ");
-  Serial.println(_configs[1], BIN);
+  LOG_DEFERRED(DRIVER, DEBUG, "PINS 0-7: %02X PINS 8-15: %02X\n", _configs[0], _configs[1]);
 
   // Send them to the expander
   _i2c_interface->beginTransmission(_i2c_address);
@@ -137,34 +133,17 @@ void MAX7314::configureOutputs(MAX7314_StaticPins outputBitfield) {
  */
 uint16_t MAX7314::readInputs() {
   uint16_t inputRead = 0;
-
-  // Set the register to read from
-  _i2c_interface->beginTransmission(_i2c_address);
-  _i2c_interface->write(INPUT_REGISTER_0);
-  _i2c_interface->endTransmission();
-  _i2c_interface->requestFrom(_i2c_address, (uint8_t)2);
-
-  // #ifdef DEBUG
-  //   char result[80];
-  //   snprintf(
-  //     result,
-  //     80,
-  //     "GpioExpander::readInputs(): <0x%.2X> <0x%.2X> <0x%.2X> <0x%.2X> ",
-  //     _i2c_address,
-  //     OUTPUT_REGISTER_0,
-  //     _staticOutputs[0],
-  //     _staticOutputs[1]
-  //   );
-  //   Serial.println(String(result));
-  // #endif
+  uint8_t inputs[2];
 
   // Make sure we got a response
-  if (_i2c_interface->available() >= 2) {
+  if (i2cWriteRead(_i2c_interface, _i2c_address, INPUT_REGISTER_0, inputs, 2) == 2) {
     // Read pins 0-7 first.
-    inputRead = _i2c_interface->read();
-    inputRead |= ((_i2c_interface->read()) << 8);
+    inputRead = inputs[0];
+    inputRead |= (inputs[1] << 8);
   }
 
+  LOG_DEFERRED(DRIVER, DEBUG, "MAX7314::readInputs(): <0x%02X> <0x%04X>\n", _i2c_address, inputRead);
+
   return inputRead;
 }
 
@@ -181,20 +160,8 @@ void MAX7314::setStaticOutputs(MAX7314_StaticPins pinSetBitfield) {
   _i2c_interface->write(_staticOutputs[1]);
   _i2c_interface->endTransmission();
 
-  // #ifdef DEBUG
-  //   char result[80];
-  //   snprintf(
-  //     result,
-  //     80,
-  //     "GpioExpander::setStaticOutputs(0x%.4X): <0x%.2X> <0x%.2X> <0x%.2X> <0x%.2X> ",
-  //     pinSetBitfield,
-  //     _i2c_address,
-  //     OUTPUT_REGISTER_0,
-  //     _staticOutputs[0],
-  //     _staticOutputs[1]
-  //   );
-  //   Serial.println(String(result));
-  // #endif
+  LOG_DEFERRED(DRIVER, DEBUG, "MAX7314::setStaticOutputs(0x%04X): <0x%02X> <0x%02X> <0x%02X>\n",
+               pinSetBitfield, _i2c_address, _staticOutputs[0], _staticOutputs[1]);
 }
 
 void MAX7314::clearStaticOutputs(MAX7314_StaticPins pinClearBitfield) {
@@ -210,20 +177,8 @@ void MAX7314::clearStaticOutputs(MAX7314_StaticPins pinClearBitfield) {
   _i2c_interface->write(_staticOutputs[1]);
   _i2c_interface->endTransmission();
 
-  // #ifdef DEBUG
-  //   char result[80];
-  //   snprintf(
-  //     result,
-  //     80,
-  //     "GpioExpander::clearStaticOutputs(0x%.4X): <0x%.2X> <0x%.2X> <0x%.2X> <0x%.2X> ",
-  //     pinClearBitfield,
-  //     _i2c_address,
-  //     OUTPUT_REGISTER_0,
-  //     _staticOutputs[0],
-  //     _staticOutputs[1]
-  //   );
-  //   Serial.println(String(result));
-  // #endif
+  LOG_DEFERRED(DRIVER, DEBUG, "MAX7314::clearStaticOutputs(0x%04X): <0x%02X> <0x%02X> <0x%02X>\n",
+               pinClearBitfield, _i2c_address, _staticOutputs[0], _staticOutputs[1]);
 }
 
 void MAX7314::setOutputPwmValue(MAX7314_PwmPins pin, uint8_t dutyCycle) {
@@ -274,18 +229,6 @@ void MAX7314::setOutputPwmValue(MAX7314_PwmPins pin, uint8_t dutyCycle) {
   _i2c_interface->write(_pwmOutputs[pwm_index]);
   _i2c_interface->endTransmission();
 
-  // #ifdef DEBUG
-  //   char result[80];
-  //   snprintf(
-  //    result,
-  //    80,
-  //    "GpioExpander::setOutputPwmValue(0x%.4X, %d): <0x%.2X> <0x%.2X> <0x%.2X> <0x%.2X> ",
-  //    pin,
-  //    dutyCycle,
-  //    _address,
-  //    OUTPUT_REGISTER_0,
-  //    _staticOutputs[0],
-  //    _staticOutputs[1]);
-  //   Serial.println(String(result));
-  // #endif
+  LOG_DEFERRED(DRIVER, DEBUG, "MAX7314::setOutputPwmValue(%u, %u): <0x%02X> <0x%02X>\n",
+               pin, dutyCycle, _i2c_address, _pwmOutputs[pwm_index]);
 }
@@ -9,7 +9,6 @@
 #include <Wire.h>
 
 // #define GPIO_EXPANDER_VERSION "MAX7314 Driver v1.0.1\r\n"
-// #define DEBUG
 
 /*
   Enum of GPIO expander I2C addresses.
@@ -1,176 +1,176 @@
 #include <Wire.h>
 #include <HardwareSerial.h>
 #include "src/MAX7314/MAX7314.hpp"
+#include "src/Board/BoardDescription.hpp"
+#include "src/I2CBus/I2CBus.hpp"
+#include "src/DeferredLog/DeferredLog.hpp"
+#include "src/LogLevel/LogLevel.hpp"
+#include "src/Profile/Profile.hpp"
+#include "src/RS485/RS485Port.hpp"
+#include "src/Modbus/ModbusFrame.hpp"
 
 HardwareSerial uart2(2);
-
-// I2C Comms
-const int8_t kSDA = 32;
-const int8_t kSCL = 33;
+// Drives the transceiver's DE from the UART's transmit complete
+RS485Port rs485;
 
 MAX7314 expanderOne;
 MAX7314 expanderTwo;
-int de_pin = 13;
-
-enum MessageIndex {
-  ID,
-  FC,
-  ADD_HIGH,
-  ADD_LOW,
-  COIL_HIGH,
-  COIL_LOW,
-  CRC_HIGH,
-  CRC_LOW
-};
 
-uint8_t test_message[] = { 0x01, 0x03, 0x00, 0x00, 0x00, 0x02, 0x44, 0x09 };
-uint8_t message_length = 8;
+// Both expanders run at 400 kHz, anything else at the 100 kHz default
+I2CBus i2c_bus;
+const uint32_t expander_clock_hz = 400000;
 
-const uint8_t buffer_length = 256;
+const uint16_t buffer_length = 256;
 uint8_t buffer[buffer_length];
-uint8_t buffer_index = 0;
+uint16_t buffer_index = 0;
 
-uint8_t server_id = 1;
-uint8_t function_code = 3;
-uint16_t register_address = 0;
-uint16_t coil_count = 2;
+// Requests sent in turn, one per interval. The frames, CRCs included,
+// are built by the compiler.
+constexpr ModbusRequestFrame poll_list[] = {
+  modbusRequest(1, 0x03, 0x0000, 2),  // Server 1, 2 holding registers from 0
+};
+const uint8_t poll_count = sizeof(poll_list) / sizeof(poll_list[0]);
+uint8_t poll_index = 0;
+const ModbusRequestFrame *last_request = &poll_list[0];
 
-void setup() {
-  Wire.begin(kSDA, kSCL);
-  Serial.begin(115200);
-  uart2.begin(19200, SERIAL_8E1, 16, 17);
+// CRC goes out low byte first
+static_assert(poll_list[0].bytes[6] == 0xC4 && poll_list[0].bytes[7] == 0x0B, "Modbus CRC byte order");
 
-  pinMode(de_pin, OUTPUT);
+// Time between requests, spent draining the log
+const unsigned long request_interval = 1000;
+// Longest a server may take to answer, response included
+const unsigned long response_timeout_ms = 100;
 
-  expanderOne.init(&Wire, 0x20, NULL, 0);
-  expanderOne.configurePins(0xFF00);
-  expanderTwo.init(&Wire, 0x24, NULL, 0);
-  expanderTwo.configurePins(0x0000);
+PROFILE_PROBE(send_message);
+PROFILE_PROBE(read_message);
 
-  expanderTwo.setPinsLow(STATIC_PIN2);
+void setup() {
+  Wire.begin(BOARD_EXPANDER_SDA, BOARD_EXPANDER_SCL);
+  Serial.begin(115200);
+
+  i2c_bus.begin(&Wire);
+  i2c_bus.setDeviceClock(BOARD_EXPANDER_1_ADDRESS, expander_clock_hz);
+  i2c_bus.setDeviceClock(BOARD_EXPANDER_2_ADDRESS, expander_clock_hz);
 
-  buffer[ID] = server_id;
-  buffer[FC] = function_code;
-  buffer[ADD_HIGH] = highByte(register_address);
-  buffer[ADD_LOW] = lowByte(register_address);
-  buffer[COIL_HIGH] = highByte(coil_count);
-  buffer[COIL_LOW] = lowByte(coil_count);
+  // Pin roles and start-up levels are in src/Board/BoardDescription.hpp
+  expanderOne.init(&i2c_bus, BOARD_EXPANDER_1_ADDRESS, kExpander1Image);
+  expanderTwo.init(&i2c_bus, BOARD_EXPANDER_2_ADDRESS, kExpander2Image);
 
-  uint16_t crc_val = get_crc(buffer, 6);
-  buffer[CRC_HIGH] = highByte(crc_val);
-  buffer[CRC_LOW] = lowByte(crc_val);
+#if BOARD_RS485_DE_ON_EXPANDER
+  rs485.begin(&uart2, 19200, SERIAL_8E1, 16, 17, expander_drive_enable, NULL);
+#else
+  rs485.begin(&uart2, 19200, SERIAL_8E1, 16, 17, BOARD_RS485_DE);
+#endif
 
-  for (int i = 0; i < buffer_length; i++) {
-    Serial.print(buffer[i], HEX);
-    Serial.print(" ");
+  for (uint8_t i = 0; i < poll_count; i++) {
+    LOG_DEFERRED_BYTES(MODBUS, INFO, "REQUEST: ", poll_list[i].bytes, MODBUS_REQUEST_LENGTH);
   }
-  Serial.println();
-  uart2.flush();
+  rs485.flush();
 }
 
 void loop() {
 
-  if (uart2.read() == -1) {
-    Serial.println("READ = -1, FLUSH UART2");
-  }
-
-  Serial.println("SEND MESSAGE");
-  send_message();
+  LOG_DEFERRED(MODBUS, DEBUG, "SEND MESSAGE\n");
+  if (send_message()) {
+    LOG_DEFERRED(MODBUS, DEBUG, "READ MESSAGE\n");
+    read_message();
 
-  Serial.println("READ MESSAGE");
-  read_message();
-
-  Serial.println("PRINT MESSAGE");
-  print_message();
-  delay(1000);
+    LOG_DEFERRED(MODBUS, DEBUG, "PRINT MESSAGE\n");
+    print_message();
+  }
 
+  // Idle time, let the log catch up
+  unsigned long idle_start = millis();
+  while (millis() - idle_start < request_interval) {
+    Log.drain(Serial);
+    // Send 'p' to dump the timing histograms
+    if (Serial.read() == 'p') {
+      PROFILE_DUMP(Serial);
+    }
+    yield();
+  }
+  if (Log.dropped() > 0) {
+    LOG_PRINTF(MODBUS, WARN, "LOG DROPPED: %u\n", Log.dropped());
+  }
 }
 
-void pre_send() {
-  digitalWrite(de_pin, HIGH);
+bool expander_drive_enable(bool high, void *context) {
+  return expanderTwo.setPinsFast(kBoardRS485DEExpanderPin, high);
 }
 
-void post_send() {
-  digitalWrite(de_pin, LOW);
-}
+bool send_message() {
+  PROFILE_SCOPE(send_message);
+  const ModbusRequestFrame &request = poll_list[poll_index];
+  poll_index = (poll_index + 1) % poll_count;
+  last_request = &request;
+
+  // A reply that came in after the last timeout would be read as the
+  // answer to this request, drop everything received so far
+  uint16_t stale = 0;
+  while (rs485.available() > 0) {
+    rs485.read();
+    stale++;
+  }
+  if (stale > 0) {
+    LOG_DEFERRED(MODBUS, WARN, "DROPPED %u STALE BYTES\n", stale);
+  }
 
-void send_message() {
-  pre_send();
-  for (int i = 0; i < message_length; i++) {
-    uart2.write(buffer[i]);
+  // The whole frame goes into the TX FIFO at once. DE rises with the
+  // first byte and drops when flush() sees the last stop bit go out.
+  // Nothing is sent if DE could not be raised, there is no reply to wait for.
+  if (rs485.write(request.bytes, MODBUS_REQUEST_LENGTH) != MODBUS_REQUEST_LENGTH) {
+    LOG_DEFERRED(MODBUS, WARN, "DE NOT RAISED, REQUEST NOT SENT\n");
+    return false;
   }
-  uart2.flush();
-  post_send();
+  rs485.flush();
+
+  RS485Stats stats = rs485.stats();
+  LOG_DEFERRED(MODBUS, DEBUG, "DE HIGH %u US, %u US PAST THE FRAME (%u US NET), SWITCH %u US\n",
+               stats.last_de_us, stats.last_overhead_us, stats.last_net_overhead_us, stats.switch_us);
+  return true;
 }
 
 void read_message() {
+  PROFILE_SCOPE(read_message);
   buffer_index = 0;
-  while (uart2.available() > 0) {
-    int output = uart2.read();
+
+  // Done as soon as the last expected byte is in, no waiting for the
+  // line to go quiet
+  uint16_t expected = modbusResponseLength(*last_request);
+  if (expected > buffer_length) {
+    expected = buffer_length;
+  }
+  unsigned long start = millis();
+  uint32_t start_us = micros();
+  while (buffer_index < expected) {
+    int output = rs485.read();
+    if (output < 0) {
+      if (millis() - start >= response_timeout_ms) {
+        LOG_DEFERRED(MODBUS, WARN, "TIMEOUT AFTER %u OF %u BYTES\n", buffer_index, expected);
+        return;
+      }
+      yield();
+      continue;
+    }
     buffer[buffer_index] = output;
-    Serial.print(buffer[buffer_index], HEX);
-    Serial.print(" ");
     buffer_index++;
-  }
-  Serial.println();
-}
 
-void print_message() {
-  for (int i = 0; i < buffer_length; i++) {
-    Serial.print(buffer[i], HEX);
-    Serial.print(" ");
+    if (buffer_index == 2 && modbusIsException(buffer[1])) {
+      expected = MODBUS_EXCEPTION_LENGTH;
+    }
   }
-}
-
-void build_message() {
-  buffer[ID] = server_id;
-  buffer[FC] = function_code;
-  buffer[ADD_HIGH] = highByte(register_address);
-  buffer[ADD_LOW] = lowByte(register_address);
-  buffer[COIL_HIGH] = highByte(coil_count);
-  buffer[COIL_LOW] = lowByte(coil_count);
-
-  uint16_t crc_val = get_crc(buffer, 6);
-  buffer[CRC_HIGH] = highByte(crc_val);
-  buffer[CRC_LOW] = lowByte(crc_val);
-}
 
-static uint16_t crc16_update(uint16_t crc, uint8_t a) {
-  int i;
-
-  crc ^= a;
-  for (i = 0; i < 8; ++i) {
-    if (crc & 1)
-      crc = (crc >> 1) ^ 0xA001;
-    else
-      crc = (crc >> 1);
+  if (!modbusCrcValid(buffer, buffer_index)) {
+    LOG_DEFERRED(MODBUS, WARN, "CRC ERROR\n");
+  } else if (modbusIsException(buffer[1])) {
+    LOG_DEFERRED(MODBUS, WARN, "EXCEPTION %u\n", buffer[2]);
   }
-  return crc;
+  LOG_DEFERRED(MODBUS, DEBUG, "READ %u BYTES IN %u US\n", buffer_index, micros() - start_us);
 }
 
-// Compute the MODBUS RTU CRC
-uint16_t get_crc(uint8_t buffer[], int len) {
-  for (int i = 0; i < len; i++) {
-    Serial.print(buffer[i]);
-    Serial.print(" ");
-  }
-  Serial.println();
-  uint16_t crc = 0xFFFF;
-
-  for (int pos = 0; pos < len; pos++) {
-    crc ^= (uint16_t)buffer[pos];  // XOR byte into least sig. byte of crc
-
-    for (int i = 8; i != 0; i--) {  // Loop over each bit
-      if ((crc & 0x0001) != 0) {    // If the LSB is set
-        crc >>= 1;                  // Shift right and XOR 0xA001
-        crc ^= 0xA001;
-      } else {      // Else LSB is not set
-        crc >>= 1;  // Just shift right
-      }
-    }
-  }
-  // Note, this number has low and high bytes swapped, so use it accordingly (or swap bytes)
-  return crc;
+void print_message() {
+  // Only the bytes that actually arrived
+  LOG_DEFERRED_BYTES(MODBUS, INFO, "RESPONSE: ", buffer, buffer_index);
 }
 
 /*
@@ -0,0 +1,91 @@
+/*
+  What is wired where on the board: addresses, I2C pins, the RS485 driver enable
+  and the role and start-up level of every expander pin.
+
+  Each expander's register image is built from its pin table at compile
+  time, so setup() writes it with MAX7314::init(bus, address, image)
+  instead of a string of configure and set calls. To rewire a pin,
+  change its line here.
+*/
+
+#ifndef BOARD_DESCRIPTION_H
+#define BOARD_DESCRIPTION_H
+
+#include "../MAX7314/MAX7314.hpp"
+
+enum BoardAddresses {
+  BOARD_EXPANDER_1_ADDRESS = 0x20,
+  BOARD_EXPANDER_2_ADDRESS = 0x24,
+  BOARD_MUX_ADDRESS = 0x70,     // TCA9548A
+  BOARD_TSYS01_ADDRESS = 0x77,  // Every TSYS01, told apart by mux channel
+};
+
+enum BoardPinNumbers {
+  // The expanders' I2C bus
+  BOARD_EXPANDER_SDA = 32,
+  BOARD_EXPANDER_SCL = 33,
+  // The mux and temperature sensors' I2C bus
+  BOARD_SENSOR_SDA = 21,
+  BOARD_SENSOR_SCL = 22,
+  BOARD_RS485_DE = 13,
+};
+
+// 1 on boards with the RS485 DE on expander 2 instead of BOARD_RS485_DE
+#define BOARD_RS485_DE_ON_EXPANDER 0
+constexpr uint16_t kBoardRS485DEExpanderPin = STATIC_PIN4;
+
+/*
+  Expander 1: power enables, the RGB LED, DIP switches and alarms.
+  Outputs start high like the expander does at power-up.
+*/
+constexpr MAX7314PinSetup kExpander1Pins[16] = {
+  { MAX7314_OUTPUT, 1 },  // P0  DPUMP_PWR_EN_N  J19
+  { MAX7314_OUTPUT, 1 },  // P1  MAIN_PWR_EN     J22
+  { MAX7314_PWM, 15 },    // P2  LED_R           J26_5
+  { MAX7314_PWM, 15 },    // P3  LED_G           J26_6
+  { MAX7314_PWM, 15 },    // P4  LED_B           J26_7
+  { MAX7314_OUTPUT, 1 },  // P5  DSENS_PWR_EN    J18_4
+  { MAX7314_OUTPUT, 1 },  // P6  DENS_EN         J17_3
+  { MAX7314_OUTPUT, 1 },  // P7  DENS_DIR        J17_2
+  { MAX7314_INPUT, 0 },   // P8  MDM_STATUS      U18_4
+  { MAX7314_INPUT, 0 },   // P9  DIP_SW1
+  { MAX7314_INPUT, 0 },   // P10 DIP_SW2
+  { MAX7314_INPUT, 0 },   // P11 DIP_SW3
+  { MAX7314_INPUT, 0 },   // P12 DIP_SW4
+  { MAX7314_INPUT, 0 },   // P13 LEAK_ALARM      J25
+  { MAX7314_INPUT, 0 },   // P14 CS_LEVEL_N      J11
+  { MAX7314_INPUT, 0 },   // P15 LED_TRIG        J26_3
+};
+
+/*
+  Expander 2: modem control and the valve and 12 V PWM channel enables.
+*/
+constexpr MAX7314PinSetup kExpander2Pins[16] = {
+  { MAX7314_OUTPUT, 1 },  // P0  MDM_N_RESET       J34_5
+  { MAX7314_OUTPUT, 1 },  // P1  MDM_ON_OFF        J35_10
+  { MAX7314_OUTPUT, 0 },  // P2  MUX_SEL           U34_SEL
+  { MAX7314_OUTPUT, 1 },  // P3  BOOT_DONE         U4_2OE
+  { MAX7314_OUTPUT, !BOARD_RS485_DE_ON_EXPANDER },  // P4  EXP2_SPARE_P4 NIU, or RS485_DE receiving
+  { MAX7314_OUTPUT, 1 },  // P5  EXP2_SPARE_P5     NIU
+  { MAX7314_OUTPUT, 1 },  // P6  MDM_VREF_PWREN_N  Q13
+  { MAX7314_OUTPUT, 1 },  // P7  EXP2_SPARE_P7     NIU
+  { MAX7314_OUTPUT, 1 },  // P8  CS_VALVE1_EN      J2
+  { MAX7314_OUTPUT, 1 },  // P9  CS_12VPWM1_EN     J3
+  { MAX7314_OUTPUT, 1 },  // P10 CS_12VPWM2_EN     J4
+  { MAX7314_OUTPUT, 1 },  // P11 CS_12VPWM3_EN     J6
+  { MAX7314_OUTPUT, 1 },  // P12 CS_12VPWM4_EN     J8
+  { MAX7314_OUTPUT, 1 },  // P13 CS_VALVE6_EN      J5
+  { MAX7314_OUTPUT, 1 },  // P14 CS_VALVE7_EN      J7
+  { MAX7314_OUTPUT, 1 },  // P15 CS_VALVE8_EN      J9
+};
+
+constexpr MAX7314Image kExpander1Image = MAX7314::image(kExpander1Pins);
+constexpr MAX7314Image kExpander2Image = MAX7314::image(kExpander2Pins);
+
+// The old configurePins() values, checked against the tables
+static_assert(kExpander1Image.port_config[0] == 0x00 && kExpander1Image.port_config[1] == 0xFF,
+              "Expander 1 pins 8 - 15 are inputs");
+static_assert(kExpander2Image.port_config[0] == 0x00 && kExpander2Image.port_config[1] == 0x00,
+              "Expander 2 pins are all outputs");
+
+#endif
@@ -0,0 +1,98 @@
+/*
+  Deferred logging.
+
+  Hot paths only copy a format string pointer and a few raw arguments
+  into a lock-free ring buffer, which takes well under a microsecond and
+  never touches the UART. Formatting and transmission happen later, from
+  drain() in idle time or a low-priority task, and only as fast as the
+  UART transmit buffer has room. When the ring is full new records are
+  dropped and counted; logging never blocks.
+
+  The ring is single producer, single consumer: log from one task (or
+  one task and ISRs that don't preempt each other) and drain from one.
+*/
+
+#ifndef DEFERRED_LOG_H
+#define DEFERRED_LOG_H
+
+#include "Arduino.h"
+#include <HardwareSerial.h>
+#include <atomic>
+
+// Records buffered between drains
+#define DEFERRED_LOG_RECORDS 64
+// Arguments per formatted record, bytes per byte dump record
+#define DEFERRED_LOG_ARGS 4
+#define DEFERRED_LOG_BYTES (DEFERRED_LOG_ARGS * 4)
+
+class DeferredLog {
+public:
+  DeferredLog();
+
+  /**
+   * @brief Queues a printf-style message. Arguments are stored as raw
+   *        32-bit values, so use integer conversions (%u, %d, %X) only.
+   *
+   * @param format A string literal, it is referenced, not copied.
+   * @return false if the ring was full and the message was dropped.
+   */
+  bool log(const char *format,
+           uint32_t arg0 = 0,
+           uint32_t arg1 = 0,
+           uint32_t arg2 = 0,
+           uint32_t arg3 = 0);
+
+  /**
+   * @brief Queues a hex dump of a buffer, DEFERRED_LOG_BYTES per line.
+   *
+   * @param label A string literal printed before the bytes.
+   * @return false if any part of the dump was dropped.
+   */
+  bool logBytes(const char *label, const uint8_t *data, uint16_t length);
+
+  /**
+   * @brief Formats and sends queued records while the UART has room.
+   *
+   * @param out Serial port to write to.
+   * @param max_records Most records to send in this call.
+   * @return Number of records sent.
+   */
+  uint8_t drain(HardwareSerial &out, uint8_t max_records = DEFERRED_LOG_RECORDS);
+
+  /**
+   * @brief Records dropped because the ring was full.
+   */
+  uint32_t dropped();
+
+private:
+  enum RecordKind {
+    FORMAT,
+    BYTES,
+  };
+
+  struct Record {
+    const char *format;
+    uint8_t kind;
+    uint8_t length;
+    union {
+      uint32_t args[DEFERRED_LOG_ARGS];
+      uint8_t bytes[DEFERRED_LOG_BYTES];
+    };
+  };
+
+  static const uint8_t _kLineSize = 96;
+
+  Record _records[DEFERRED_LOG_RECORDS];
+  std::atomic<uint16_t> _head;
+  std::atomic<uint16_t> _tail;
+  std::atomic<uint32_t> _dropped;
+
+  Record *claim();
+  void publish();
+  uint8_t format(const Record &record, char *line);
+};
+
+// Shared by the sketch and the drivers it uses
+extern DeferredLog Log;
+
+#endif
@@ -0,0 +1,64 @@
+/*
+  Compile-time log levels per module.
+
+  Each module has its own level, set below or with a build flag such as
+  -DLOG_LEVEL_DRIVER=LOG_LEVEL_DEBUG. A log call above its module's
+  level is a constant-false branch, so the call and its format string
+  are dropped from the build while the arguments are still type checked.
+  tools/sim/log_level_cost.sh measures what DEBUG costs against NONE.
+
+  LOG_PRINTF writes straight to Serial and blocks on the UART.
+  LOG_DEFERRED and LOG_DEFERRED_BYTES queue to the DeferredLog ring and
+  need DeferredLog.hpp included.
+*/
+
+#ifndef LOG_LEVEL_H
+#define LOG_LEVEL_H
+
+#include "Arduino.h"
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+// Peripheral drivers: GPIO expanders, mux, bus helpers
+#ifndef LOG_LEVEL_DRIVER
+#define LOG_LEVEL_DRIVER LOG_LEVEL_WARN
+#endif
+
+// Modbus requests and responses
+#ifndef LOG_LEVEL_MODBUS
+#define LOG_LEVEL_MODBUS LOG_LEVEL_INFO
+#endif
+
+// Temperature sensors and acquisition
+#ifndef LOG_LEVEL_SENSOR
+#define LOG_LEVEL_SENSOR LOG_LEVEL_WARN
+#endif
+
+#define LOG_ENABLED(module, level) (LOG_LEVEL_##module >= LOG_LEVEL_##level)
+
+#define LOG_PRINTF(module, level, ...) \
+  do { \
+    if (LOG_ENABLED(module, level)) { \
+      Serial.printf(__VA_ARGS__); \
+    } \
+  } while (0)
+
+#define LOG_DEFERRED(module, level, ...) \
+  do { \
+    if (LOG_ENABLED(module, level)) { \
+      Log.log(__VA_ARGS__); \
+    } \
+  } while (0)
+
+#define LOG_DEFERRED_BYTES(module, level, label, data, length) \
+  do { \
+    if (LOG_ENABLED(module, level)) { \
+      Log.logBytes(label, data, length); \
+    } \
+  } while (0)
+
+#endif
@@ -3,6 +3,7 @@
 */
 #include "MAX7314.hpp"
 #include "Arduino.h"
+#include "../Profile/Profile.hpp"
 
 // Uncomment if using Arduino IDE
 // MAX7314::MAX7314() {}
@@ -18,17 +19,13 @@ void MAX7314::init(
   _i2c_address = i2c_address;
 
   // Config Register
-  _i2c_interface->beginTransmission(_i2c_address);
-  _i2c_interface->write(CONFIG_REGISTER);
-  _i2c_interface->write(CONFIG_REGISTER_VALUE);
-  _i2c_interface->endTransmission();
+  const uint8_t config = CONFIG_REGISTER_VALUE;
+  writeRegisters(CONFIG_REGISTER, &config, 1);
 
   // PWM Master Intensity
   // Set this to a nonzero value to enable PWM.
-  _i2c_interface->beginTransmission(_i2c_address);
-  _i2c_interface->write(MASTER_INTENSITY_REGISTER);
-  _i2c_interface->write(MASTER_INTENSITY_VALUE_NONZERO);
-  _i2c_interface->endTransmission();
+  const uint8_t intensity = MASTER_INTENSITY_VALUE_NONZERO;
+  writeRegisters(MASTER_INTENSITY_REGISTER, &intensity, 1);
 
   // Set up GPIO callback
   if (interrupt_callback != NULL)
@@ -37,62 +34,236 @@ void MAX7314::init(
   }
 }
 
-void MAX7314::configurePins(uint16_t bit_field)
+void MAX7314::init(
+    I2CBus *bus,
+    uint8_t i2c_address,
+    void (*interrupt_callback)(void),
+    uint8_t interrupt_pin)
 {
-  uint8_t low_bits = (bit_field & 0xff);
-  uint8_t high_bits = (bit_field >> 8);
+  _bus = bus;
+  init(bus->wire(), i2c_address, interrupt_callback, interrupt_pin);
+}
 
-  _i2c_interface->beginTransmission(_i2c_address);
-  _i2c_interface->write(PORT_CONFIG_REGISTER_0);
-  _i2c_interface->write(low_bits);
-  _i2c_interface->write(high_bits);
-  _i2c_interface->endTransmission();
+bool MAX7314::init(
+    I2CBus *bus,
+    uint8_t i2c_address,
+    const MAX7314Image &image,
+    void (*interrupt_callback)(void),
+    uint8_t interrupt_pin)
+{
+  _bus = bus;
+  _i2c_interface = bus->wire();
+  _i2c_address = i2c_address;
+
+  bool ok = writeImage(image);
+
+  // Set up GPIO callback
+  if (interrupt_callback != NULL)
+  {
+    attachInterrupt(digitalPinToInterrupt(interrupt_pin), interrupt_callback, FALLING);
+  }
+  return ok;
+}
+
+// configuration and intensity go out as one burst from 0x0F onwards
+static_assert(offsetof(MAX7314Image, intensity) == offsetof(MAX7314Image, master) + sizeof(MAX7314Image::master),
+              "master and intensity must be adjacent, like their registers");
+
+bool MAX7314::writeImage(const MAX7314Image &image)
+{
+  // One transaction, no other task sees the expander half set up
+  I2CTransaction transaction(_bus, _i2c_address);
+  _output_states[0] = image.outputs[0];
+  _output_states[1] = image.outputs[1];
+  _pin_config = image.port_config[0] | (image.port_config[1] << 8);
+
+  // Outputs (0x02), port configuration (0x06) and configuration and
+  // intensity (0x0F - 0x17) are three separate runs of registers, one
+  // burst each. Master (0x0E) enables PWM, so it goes last on its own,
+  // once the duties are in, instead of ahead of them in the last run.
+  return writeRegisters(OUTPUT_REGISTER_0, image.outputs, sizeof(image.outputs))
+         && writeRegisters(PORT_CONFIG_REGISTER_0, image.port_config, sizeof(image.port_config))
+         && writeRegisters(CONFIG_REGISTER, &image.master[1],
+                           sizeof(image.master) - 1 + sizeof(image.intensity))
+         && writeRegisters(MASTER_INTENSITY_REGISTER, image.master, 1);
+}
+
+bool MAX7314::configurePins(uint16_t bit_field)
+{
+  uint8_t bits[2] = { (uint8_t)(bit_field & 0xff), (uint8_t)(bit_field >> 8) };
+  _pin_config = bit_field;
+  return writeRegisters(PORT_CONFIG_REGISTER_0, bits, sizeof(bits));
 }
 
+PROFILE_PROBE(max7314_read_pins);
+
 uint16_t MAX7314::readPins()
 {
   uint16_t _input_vals = 0;
+  readPins(&_input_vals);
+  return _input_vals;
+}
 
-  // Set the register to read from
-  _i2c_interface->beginTransmission(_i2c_address);
-  _i2c_interface->write(INPUT_REGISTER_0);
-  _i2c_interface->endTransmission();
-  _i2c_interface->requestFrom(_i2c_address, _kInputRequestSize);
+uint8_t MAX7314::readPins(uint16_t *pins)
+{
+  PROFILE_SCOPE(max7314_read_pins);
+  if (!_health.ready())
+  {
+    return I2C_OFFLINE;
+  }
+
+  I2CTransaction transaction(_bus, _i2c_address);
+  uint8_t inputs[_kInputRequestSize];
+  uint8_t received = i2cWriteRead(_i2c_interface, _i2c_address, INPUT_REGISTER_0,
+                                  inputs, _kInputRequestSize);
 
   // Make sure we got a response
-  if (_i2c_interface->available() >= _kInputRequestSize)
+  _health.record(received == _kInputRequestSize);
+  if (received == 0)
   {
-    // Read pins 0-7 first.
-    _input_vals = _i2c_interface->read();
-    _input_vals |= ((_i2c_interface->read()) << 8);
+    return I2C_NACK;
+  }
+  if (received < _kInputRequestSize)
+  {
+    return I2C_SHORT_READ;
   }
 
-  return _input_vals;
+  // Read pins 0-7 first.
+  *pins = inputs[0] | (inputs[1] << 8);
+  return I2C_OK;
 }
 
-void MAX7314::setPinsHigh(uint16_t bit_field)
+bool MAX7314::setPinsHigh(uint16_t bit_field)
 {
   // Set pins 0-7 first.
   _output_states[0] |= (bit_field & 0xff);
   _output_states[1] |= (bit_field >> 8);
-
-  _i2c_interface->beginTransmission(_i2c_address);
-  _i2c_interface->write(OUTPUT_REGISTER_0);
-  _i2c_interface->write(_output_states[0]);
-  _i2c_interface->write(_output_states[1]);
-  _i2c_interface->endTransmission();
+  return writeRegisters(OUTPUT_REGISTER_0, _output_states, sizeof(_output_states));
 }
 
-void MAX7314::setPinsLow(uint16_t bit_field)
+bool MAX7314::setPinsLow(uint16_t bit_field)
 {
   // Clear the bitfield we got from  our saved outputs
   // Set pins 0-7 first.
   _output_states[0] &= ~(bit_field & 0xFF);
   _output_states[1] &= ~(bit_field >> 8);
+  return writeRegisters(OUTPUT_REGISTER_0, _output_states, sizeof(_output_states));
+}
+
+bool MAX7314::setPinsFast(uint16_t bit_field, bool high)
+{
+  // One register per write, pins in both halves need setPinsHigh/Low
+  if ((bit_field & 0xFF) != 0 && (bit_field >> 8) != 0)
+  {
+    return false;
+  }
+  uint8_t half = (bit_field & 0xFF) != 0 ? 0 : 1;
+  uint8_t mask = half == 0 ? (bit_field & 0xFF) : (bit_field >> 8);
+  uint8_t outputs = high ? (_output_states[half] | mask) : (_output_states[half] & ~mask);
+
+  // Register byte plus one data byte, the other half is left alone. The
+  // cache only takes the new level once the expander has it.
+  if (!writeRegisters(OUTPUT_REGISTER_0 + half, &outputs, 1, I2C_PRIORITY_HIGH))
+  {
+    return false;
+  }
+  _output_states[half] = outputs;
+  return true;
+}
+
+bool MAX7314::readPinsAsync(I2CCallback callback, void *context)
+{
+  if (_bus == NULL || _read_request.status == I2C_PENDING)
+  {
+    return false;
+  }
+
+  _read_request.address = _i2c_address;
+  _read_request.tx = &_read_register;
+  _read_request.tx_length = 1;
+  _read_request.rx = _read_buffer;
+  _read_request.rx_length = _kInputRequestSize;
+  _read_request.priority = I2C_PRIORITY_NORMAL;
+  _read_request.callback = callback;
+  _read_request.context = context;
+  _read_request.health = &_health;
+  return _bus->submit(&_read_request);
+}
+
+uint8_t MAX7314::asyncPins(uint16_t *pins)
+{
+  if (_read_request.status == I2C_OK)
+  {
+    // Read pins 0-7 first.
+    *pins = _read_buffer[0] | (_read_buffer[1] << 8);
+  }
+  return _read_request.status;
+}
+
+bool MAX7314::setPinsHighAsync(uint16_t bit_field)
+{
+  if (_bus == NULL || _write_request.status == I2C_PENDING)
+  {
+    return false;
+  }
+  _output_states[0] |= (bit_field & 0xff);
+  _output_states[1] |= (bit_field >> 8);
+  return writeOutputsAsync();
+}
+
+bool MAX7314::setPinsLowAsync(uint16_t bit_field)
+{
+  if (_bus == NULL || _write_request.status == I2C_PENDING)
+  {
+    return false;
+  }
+  _output_states[0] &= ~(bit_field & 0xFF);
+  _output_states[1] &= ~(bit_field >> 8);
+  return writeOutputsAsync();
+}
+
+bool MAX7314::asyncBusy()
+{
+  return _read_request.status == I2C_PENDING || _write_request.status == I2C_PENDING;
+}
 
+bool MAX7314::writeOutputsAsync()
+{
+  // The request sends a snapshot, later changes need their own write
+  _write_buffer[0] = OUTPUT_REGISTER_0;
+  _write_buffer[1] = _output_states[0];
+  _write_buffer[2] = _output_states[1];
+
+  _write_request.address = _i2c_address;
+  _write_request.tx = _write_buffer;
+  _write_request.tx_length = sizeof(_write_buffer);
+  _write_request.rx = NULL;
+  _write_request.rx_length = 0;
+  _write_request.priority = I2C_PRIORITY_NORMAL;
+  _write_request.callback = NULL;
+  _write_request.context = NULL;
+  _write_request.health = &_health;
+  return _bus->submit(&_write_request);
+}
+
+bool MAX7314::online()
+{
+  return _health.online();
+}
+
+bool MAX7314::writeRegisters(uint8_t reg, const uint8_t *values, uint8_t length, uint8_t priority)
+{
+  if (!_health.ready())
+  {
+    return false;
+  }
+
+  I2CTransaction transaction(_bus, _i2c_address, priority);
   _i2c_interface->beginTransmission(_i2c_address);
-  _i2c_interface->write(OUTPUT_REGISTER_0);
-  _i2c_interface->write(_output_states[0]);
-  _i2c_interface->write(_output_states[1]);
-  _i2c_interface->endTransmission();
+  _i2c_interface->write(reg);
+  _i2c_interface->write(values, length);
+  bool ok = _i2c_interface->endTransmission() == 0;
+
+  _health.record(ok);
+  return ok;
 }
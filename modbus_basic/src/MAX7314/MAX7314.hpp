@@ -6,6 +6,7 @@
 #define MAX7314_H
 
 #include <Wire.h>
+#include "../I2CBus/I2CBus.hpp"
 // #include "pinmap.h"
 
 
@@ -130,6 +131,33 @@ enum PwmPins {
 
 
 
+/*
+  Start-up setup of one pin, for building a register image.
+*/
+enum MAX7314PinRole {
+  MAX7314_INPUT,
+  MAX7314_OUTPUT,
+  MAX7314_PWM,
+};
+
+struct MAX7314PinSetup {
+  uint8_t role;
+  // 0 or 1 for an output, 0 - 15 sixteenths duty for PWM, unused for an input
+  uint8_t level;
+};
+
+/*
+  Every writable register the driver sets up, in register order within
+  each block. master and intensity are adjacent on the expander (0x0E -
+  0x17), configuration and intensity are written as one block and master
+  after them. Build one with MAX7314::image().
+*/
+struct MAX7314Image {
+  uint8_t outputs[2];
+  uint8_t port_config[2];
+  uint8_t master[2];     // Master intensity, then configuration
+  uint8_t intensity[8];  // Two pins per register, even pin in the low nibble
+};
 
 class MAX7314 {
 
@@ -150,8 +178,10 @@ private:
     MASTER_INTENSITY_VALUE_NONZERO = 0xFF
   };
 
+  I2CBus *_bus = NULL;
   TwoWire *_i2c_interface;
   uint8_t _i2c_address;
+  I2CDeviceHealth _health;
 
   uint16_t _pin_config = 0xFFFF;
 
@@ -161,6 +191,44 @@ private:
   // Pin output values.
   const uint8_t _kInputRequestSize = 2;
 
+  // Transfers run by the bus worker
+  I2CRequest _read_request = {};
+  uint8_t _read_register = INPUT_REGISTER_0;
+  uint8_t _read_buffer[2];
+  I2CRequest _write_request = {};
+  uint8_t _write_buffer[3];
+
+  bool writeOutputsAsync();
+  bool writeRegisters(uint8_t reg,
+                      const uint8_t *values,
+                      uint8_t length,
+                      uint8_t priority = I2C_PRIORITY_NORMAL);
+
+  // Register bytes for pins first to first + 7, see image()
+  static constexpr uint8_t outputBits(const MAX7314PinSetup *pins, uint8_t first, uint8_t i = 0) {
+    return i == 8 ? 0
+                  : (uint8_t)(((pins[first + i].role == MAX7314_INPUT
+                                || pins[first + i].role == MAX7314_PWM
+                                || pins[first + i].level != 0)
+                               << i)
+                              | outputBits(pins, first, i + 1));
+  }
+
+  static constexpr uint8_t inputBits(const MAX7314PinSetup *pins, uint8_t first, uint8_t i = 0) {
+    return i == 8 ? 0
+                  : (uint8_t)(((pins[first + i].role == MAX7314_INPUT) << i)
+                              | inputBits(pins, first, i + 1));
+  }
+
+  // Static pins keep the power-up full intensity
+  static constexpr uint8_t duty(const MAX7314PinSetup &pin) {
+    return pin.role == MAX7314_PWM ? (pin.level & 0x0F) : 0x0F;
+  }
+
+  static constexpr uint8_t intensityPair(const MAX7314PinSetup *pins, uint8_t pair) {
+    return (uint8_t)(duty(pins[2 * pair]) | (duty(pins[2 * pair + 1]) << 4));
+  }
+
 public:
   // Uncomment if using with Arduino IDE.
   // MAX7314();
@@ -188,21 +256,83 @@ public:
             void (*input_callback)(void),
             uint8_t interrupt_pin);
 
+  /**
+   * @brief Initializes the expander on a shared bus manager. Every
+   *        register access then holds the bus.
+   */
+  void init(I2CBus *bus,
+            uint8_t i2c_address,
+            void (*input_callback)(void),
+            uint8_t interrupt_pin);
+
+  /**
+   * @brief Initializes the expander on a shared bus manager from a
+   *        register image, see image().
+   *
+   * @return false if the expander did not acknowledge.
+   */
+  bool init(I2CBus *bus,
+            uint8_t i2c_address,
+            const MAX7314Image &image,
+            void (*input_callback)(void) = NULL,
+            uint8_t interrupt_pin = 0);
+
+  /**
+   * @brief Builds the complete register image for a pin setup. Meant to
+   *        run at compile time, e.g.
+   *        constexpr MAX7314Image kImage = MAX7314::image(kPins);
+   *
+   * Outputs are written before the port configuration, so pins come up
+   * at their initial level without a glitch.
+   *
+   * @param pins Setup of pins 0 - 15.
+   */
+  static constexpr MAX7314Image image(const MAX7314PinSetup (&pins)[16]) {
+    return MAX7314Image{
+      { outputBits(pins, 0), outputBits(pins, 8) },
+      { inputBits(pins, 0), inputBits(pins, 8) },
+      { MASTER_INTENSITY_VALUE_NONZERO, CONFIG_REGISTER_VALUE },
+      { intensityPair(pins, 0), intensityPair(pins, 1), intensityPair(pins, 2), intensityPair(pins, 3),
+        intensityPair(pins, 4), intensityPair(pins, 5), intensityPair(pins, 6), intensityPair(pins, 7) },
+    };
+  }
+
+  /**
+   * @brief Writes a register image in three bursts, one per block of
+   *        adjacent registers, then master intensity last so PWM only
+   *        starts with its duties in place. All in one bus transaction.
+   *        Also restores the image after the expander has been power
+   *        cycled.
+   *
+   * @return false if the expander is offline or did not acknowledge.
+   */
+  bool writeImage(const MAX7314Image &image);
+
   /**
    * @brief Configures pins as inputs or outputs.
    *        1 = INPUT, 0 = OUTPUT
    *
    * @param bit_field A bitfield of pins to be configured.
+   * @return false if the expander is offline or did not acknowledge.
    */
-  void configurePins(uint16_t bit_field);
+  bool configurePins(uint16_t bit_field);
 
   /**
    * @brief Reads GPIO input values.
    *
-   * @return A bitfield of pin values.
+   * @return A bitfield of pin values, 0 if the read failed.
    */
   uint16_t readPins();
 
+  /**
+   * @brief Reads GPIO input values, failing at once while the expander
+   *        is offline.
+   *
+   * @param pins Receives the bitfield of pin values if the read succeeded.
+   * @return The I2CStatus of the read.
+   */
+  uint8_t readPins(uint16_t *pins);
+
   /**
    * @brief Sets pins configured as static GPIO outputs to high.
    *
@@ -211,8 +341,10 @@ public:
    * before they are controlled using this function.
    *
    * @param bit_field A bitfield of pins to be set high.
+   * @return false if the expander is offline or did not acknowledge.
+   *         The pins are still recorded and go out with the next write.
    */
-  void setPinsHigh(uint16_t bit_field);
+  bool setPinsHigh(uint16_t bit_field);
 
   /**
    * @brief Sets pins configured as static GPIO outputs low.
@@ -222,8 +354,61 @@ public:
    * before they are controlled using this function.
    *
    * @param bit_field - A bitfield of pins to be set low.
+   * @return false if the expander is offline or did not acknowledge.
+   *         The pins are still recorded and go out with the next write.
+   */
+  bool setPinsLow(uint16_t bit_field);
+
+  /**
+   * @brief Sets pins high or low with the shortest write the expander
+   *        takes: one output register, ahead of other bus traffic. For
+   *        pins toggled around time critical work, e.g. an RS485 driver
+   *        enable.
+   *
+   * @param bit_field Pins to set, all in 0 - 7 or all in 8 - 15.
+   * @return false if the pins span both halves, nothing is written
+   *         then, or if the expander is offline or did not acknowledge.
+   */
+  bool setPinsFast(uint16_t bit_field, bool high);
+
+  /**
+   * @brief Starts reading the inputs on the bus worker and returns at once.
+   *
+   * @param callback Runs on the worker task when the read is done.
+   *                 May be NULL, poll asyncBusy() instead.
+   * @return false if the expander is not on a bus or offline, a read is
+   *         still in flight or the worker queue is full.
+   */
+  bool readPinsAsync(I2CCallback callback = NULL, void *context = NULL);
+
+  /**
+   * @brief Result of the last asynchronous read.
+   *
+   * @param pins Receives the bitfield of pin values if the read succeeded.
+   * @return The I2CStatus of the read.
+   */
+  uint8_t asyncPins(uint16_t *pins);
+
+  /**
+   * @brief setPinsHigh() and setPinsLow() with the write run on the bus
+   *        worker.
+   *
+   * @return false if the expander is not on a bus or the previous write
+   *         is still in flight, the outputs are left unchanged then.
+   */
+  bool setPinsHighAsync(uint16_t bit_field);
+  bool setPinsLowAsync(uint16_t bit_field);
+
+  /**
+   * @brief true while an asynchronous read or write is in flight.
+   */
+  bool asyncBusy();
+
+  /**
+   * @brief false once the expander has stopped answering. It is probed
+   *        again on a backoff while offline, see I2CDeviceHealth.
    */
-  void setPinsLow(uint16_t bit_field);
+  bool online();
 };
 
 #endif
@@ -0,0 +1,119 @@
+/*
+  Modbus RTU request frames built at compile time.
+
+  A poll list entry never changes once its server, function code,
+  address and count are set, so its whole ADU, CRC included, can be a
+  constant. modbusRequest() is constexpr: a constexpr table of frames is
+  built by the compiler, lives in flash and costs nothing per request.
+  Each frame goes out with one block write.
+
+  modbusCrc() is the same CRC at run time, for checking responses.
+
+  The length of a response is known from its request, so a receiver can
+  treat it as complete the moment the last byte arrives rather than
+  waiting for the t3.5 silence. An exception response is
+  MODBUS_EXCEPTION_LENGTH bytes instead, which shows in its second byte.
+*/
+
+#ifndef MODBUS_FRAME_H
+#define MODBUS_FRAME_H
+
+#include "Arduino.h"
+
+// Server id, function code, 2 byte address, 2 byte count/value, CRC
+#define MODBUS_REQUEST_LENGTH 8
+// Server id, function code | 0x80, exception code, CRC
+#define MODBUS_EXCEPTION_LENGTH 5
+
+struct ModbusRequestFrame {
+  uint8_t bytes[MODBUS_REQUEST_LENGTH];
+};
+
+/**
+ * @brief Shifts the CRC through the given number of bits.
+ */
+constexpr uint16_t modbusCrcBits(uint16_t crc, uint8_t bits) {
+  return bits == 0 ? crc
+                   : modbusCrcBits((crc & 0x0001) ? (crc >> 1) ^ 0xA001 : (crc >> 1), bits - 1);
+}
+
+/**
+ * @brief Adds one byte to a Modbus RTU CRC.
+ */
+constexpr uint16_t modbusCrcByte(uint16_t crc, uint8_t value) {
+  return modbusCrcBits(crc ^ value, 8);
+}
+
+// Big endian, the way addresses, counts and values go on the wire
+constexpr uint16_t modbusCrcWord(uint16_t crc, uint16_t value) {
+  return modbusCrcByte(modbusCrcByte(crc, value >> 8), value & 0xFF);
+}
+
+/**
+ * @brief Modbus RTU CRC over length bytes. Goes on the wire low byte
+ *        first.
+ */
+inline uint16_t modbusCrc(const uint8_t *data, uint16_t length) {
+  uint16_t crc = 0xFFFF;
+  for (uint16_t i = 0; i < length; i++) {
+    crc = modbusCrcByte(crc, data[i]);
+  }
+  return crc;
+}
+
+constexpr ModbusRequestFrame modbusFrame(uint8_t server, uint8_t function,
+                                         uint8_t address_high, uint8_t address_low,
+                                         uint8_t value_high, uint8_t value_low, uint16_t crc) {
+  return ModbusRequestFrame{ { server, function, address_high, address_low,
+                               value_high, value_low,
+                               (uint8_t)(crc & 0xFF), (uint8_t)(crc >> 8) } };
+}
+
+/**
+ * @brief Builds a complete request ADU for a read (0x01 - 0x04) or
+ *        single write (0x05, 0x06) function.
+ *
+ * @param server Server id
+ * @param function Function code
+ * @param address First coil or register
+ * @param value Count for reads, the value for single writes
+ */
+constexpr ModbusRequestFrame modbusRequest(uint8_t server, uint8_t function,
+                                           uint16_t address, uint16_t value) {
+  return modbusFrame(server, function, address >> 8, address & 0xFF, value >> 8, value & 0xFF,
+                     modbusCrcWord(modbusCrcWord(modbusCrcByte(modbusCrcByte(0xFFFF, server), function),
+                                                 address),
+                                   value));
+}
+
+/**
+ * @brief Length, CRC included, of the normal response to a request.
+ *        Single and multiple writes are answered with 8 bytes.
+ */
+constexpr uint16_t modbusResponseLength(const ModbusRequestFrame &request) {
+  return request.bytes[1] == 0x01 || request.bytes[1] == 0x02
+           ? 5 + ((request.bytes[4] << 8 | request.bytes[5]) + 7) / 8
+         : request.bytes[1] == 0x03 || request.bytes[1] == 0x04
+           ? 5 + 2 * (request.bytes[4] << 8 | request.bytes[5])
+           : 8;
+}
+
+/**
+ * @brief True if a response's function code marks an exception.
+ */
+constexpr bool modbusIsException(uint8_t function) {
+  return (function & 0x80) != 0;
+}
+
+/**
+ * @brief Checks the CRC at the end of a received frame.
+ */
+inline bool modbusCrcValid(const uint8_t *frame, uint16_t length) {
+  if (length < 4) {
+    return false;
+  }
+  uint16_t crc = modbusCrc(frame, length - 2);
+  return frame[length - 2] == (crc & 0xFF) && frame[length - 1] == (crc >> 8);
+}
+
+#endif
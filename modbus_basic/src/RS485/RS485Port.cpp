@@ -0,0 +1,204 @@
+#include "RS485Port.hpp"
+
+RS485Port::RS485Port() {
+  _uart = NULL;
+  _de_pin = -1;
+  _hardware_de = false;
+  _drive_enable = NULL;
+  _drive_enable_context = NULL;
+  _byte_ns = 0;
+  _transmitting = false;
+  _tx_empty_space = 0;
+  _tx_start_us = 0;
+  _tx_bytes = 0;
+  _last_switch_us = 0;
+  _raise_us = 0;
+  resetStats();
+}
+
+bool RS485Port::begin(HardwareSerial *uart,
+                      uint32_t baud,
+                      uint32_t config,
+                      int8_t rx_pin,
+                      int8_t tx_pin,
+                      int8_t de_pin) {
+  startUart(uart, baud, config, rx_pin, tx_pin);
+  _de_pin = de_pin;
+
+#if RS485_HARDWARE_DE
+  _hardware_de = _uart->setPins(-1, -1, -1, de_pin)
+                 && _uart->setHwFlowCtrlMode(UART_HW_FLOWCTRL_DISABLE)
+                 && _uart->setMode(UART_MODE_RS485_HALF_DUPLEX);
+#endif
+  if (!_hardware_de) {
+    pinMode(_de_pin, OUTPUT);
+    digitalWrite(_de_pin, LOW);
+  }
+  return _hardware_de;
+}
+
+void RS485Port::begin(HardwareSerial *uart,
+                      uint32_t baud,
+                      uint32_t config,
+                      int8_t rx_pin,
+                      int8_t tx_pin,
+                      RS485DriveEnable drive_enable,
+                      void *context) {
+  startUart(uart, baud, config, rx_pin, tx_pin);
+  _drive_enable = drive_enable;
+  _drive_enable_context = context;
+  // Measures the first switch time too
+  setDriveEnable(false);
+}
+
+void RS485Port::flush() {
+  if (!_transmitting) {
+    _uart->flush();
+    return;
+  }
+
+  uint32_t wire_us = (uint32_t)(((uint64_t)_tx_bytes * _byte_ns) / 1000);
+  if (_drive_enable != NULL && _stats.min_switch_us > 0) {
+    // Once the TX FIFO is empty the last character is in the shift
+    // register, so the frame ends within one character time. Timed from
+    // there, the release is started early by the fastest switch seen
+    // and DE never drops before the last stop bit, however late the
+    // frame went out.
+    while (_uart->availableForWrite() < _tx_empty_space) {
+    }
+    uint32_t char_us = (_byte_ns + 999) / 1000;
+    if (char_us > _stats.min_switch_us) {
+      delayMicroseconds(char_us - _stats.min_switch_us);
+    }
+    setDriveEnable(false);
+    _uart->flush();
+  } else {
+    // Returns once the UART reports the last stop bit sent
+    _uart->flush();
+    setDriveEnable(false);
+  }
+  _transmitting = false;
+  uint32_t release_us = _last_switch_us;
+
+  uint32_t de_us = micros() - _tx_start_us;
+  uint32_t overhead_us = de_us > wire_us ? de_us - wire_us : 0;
+  uint32_t switching_us = _raise_us + release_us;
+  uint32_t net_overhead_us = overhead_us > switching_us ? overhead_us - switching_us : 0;
+  _stats.frames++;
+  _stats.last_de_us = de_us;
+  _stats.last_overhead_us = overhead_us;
+  _stats.total_overhead_us += overhead_us;
+  if (overhead_us > _stats.max_overhead_us) {
+    _stats.max_overhead_us = overhead_us;
+  }
+  _stats.last_net_overhead_us = net_overhead_us;
+  _stats.total_net_overhead_us += net_overhead_us;
+  if (net_overhead_us > _stats.max_net_overhead_us) {
+    _stats.max_net_overhead_us = net_overhead_us;
+  }
+}
+
+size_t RS485Port::write(uint8_t value) {
+  if (!startFrame()) {
+    return 0;
+  }
+  _tx_bytes++;
+  return _uart->write(value);
+}
+
+size_t RS485Port::write(const uint8_t *buffer, size_t size) {
+  if (!startFrame()) {
+    return 0;
+  }
+  _tx_bytes += size;
+  return _uart->write(buffer, size);
+}
+
+int RS485Port::available() {
+  return _uart->available();
+}
+
+int RS485Port::read() {
+  return _uart->read();
+}
+
+int RS485Port::peek() {
+  return _uart->peek();
+}
+
+bool RS485Port::hardwareDE() {
+  return _hardware_de;
+}
+
+RS485Stats RS485Port::stats() {
+  return _stats;
+}
+
+void RS485Port::resetStats() {
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+void RS485Port::startUart(HardwareSerial *uart,
+                          uint32_t baud,
+                          uint32_t config,
+                          int8_t rx_pin,
+                          int8_t tx_pin) {
+  _uart = uart;
+
+  // SERIAL_* formats: data bits - 5 in bits 2-3, parity enabled in bit 1,
+  // stop bits in bits 4-5 (1 = one, 3 = two)
+  uint8_t data_bits = ((config >> 2) & 0x03) + 5;
+  uint8_t parity_bits = (config & 0x02) ? 1 : 0;
+  uint8_t stop_bits = ((config >> 4) & 0x03) == 3 ? 2 : 1;
+  uint32_t bit_ns = 1000000000UL / baud;
+  _byte_ns = (1 + data_bits + parity_bits + stop_bits) * bit_ns;
+
+  _uart->begin(baud, config, rx_pin, tx_pin);
+  // All of it is free while nothing is queued
+  _tx_empty_space = _uart->availableForWrite();
+  _hardware_de = false;
+}
+
+bool RS485Port::setDriveEnable(bool high) {
+  _last_switch_us = 0;
+  if (_drive_enable == NULL) {
+    if (!_hardware_de) {
+      digitalWrite(_de_pin, high ? HIGH : LOW);
+    }
+    return true;
+  }
+
+  uint32_t start_us = micros();
+  if (!_drive_enable(high, _drive_enable_context)) {
+    _stats.switch_failures++;
+    return false;
+  }
+  uint32_t switch_us = micros() - start_us;
+  _last_switch_us = switch_us;
+
+  // Smoothed, a single slow switch only moves the estimate by a quarter
+  _stats.switch_us = _stats.switch_us == 0 ? switch_us : (3 * _stats.switch_us + switch_us) / 4;
+  if (switch_us > _stats.max_switch_us) {
+    _stats.max_switch_us = switch_us;
+  }
+  if (_stats.min_switch_us == 0 || switch_us < _stats.min_switch_us) {
+    _stats.min_switch_us = switch_us;
+  }
+  return true;
+}
+
+bool RS485Port::startFrame() {
+  if (_transmitting) {
+    return true;
+  }
+  _tx_start_us = micros();
+  // Nothing may go out before DE is up, a byte sent with DE low would
+  // never reach the bus
+  if (!setDriveEnable(true)) {
+    return false;
+  }
+  _raise_us = _last_switch_us;
+  _transmitting = true;
+  _tx_bytes = 0;
+  return true;
+}
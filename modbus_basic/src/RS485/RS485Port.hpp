@@ -0,0 +1,139 @@
+/*
+  Half duplex RS485 on a HardwareSerial.
+
+  RS485Port is a Stream, so ModbusMaster and sketches talk through it
+  instead of the UART. The transceiver's driver enable (DE) goes high
+  with the first byte written and drops as soon as flush() sees the
+  UART finish the last stop bit, so the line is free for the reply
+  straight away instead of after a fixed delay().
+
+  With RS485_HARDWARE_DE the UART runs in its RS485 half duplex mode and
+  drives DE itself on the RTS pin, dropping it within a bit time of the
+  last stop bit even if this task is preempted. If the core does not
+  support the mode, DE is driven from flush() instead.
+
+  DE can also sit behind something slow, e.g. a GPIO expander pin, with
+  a RS485DriveEnable function. Every switch is timed. The frame only
+  starts once DE is up, and nothing is sent if DE could not be raised.
+  The release waits for the TX FIFO to empty, which leaves only the
+  last character on the wire, and is then started that character time
+  less the fastest switch time, so DE drops within about a character
+  of the last stop bit and never before it.
+
+  Every frame is timed. DE high time minus the frame's time on the wire
+  is the turnaround overhead, reported by stats() both as is and net of
+  the frame's two DE switch times.
+*/
+
+#ifndef RS485_PORT_H
+#define RS485_PORT_H
+
+#include "Arduino.h"
+#include <HardwareSerial.h>
+
+// Let the UART drive DE on its RTS pin. Needs arduino-esp32 2.0.5 or later.
+#define RS485_HARDWARE_DE 1
+
+/**
+ * @brief Sets DE, returning once the new level is on the pin.
+ * @return false if DE could not be set.
+ */
+typedef bool (*RS485DriveEnable)(bool high, void *context);
+
+struct RS485Stats {
+  uint32_t frames;
+  uint32_t last_de_us;        // DE high time of the last frame
+  uint32_t last_overhead_us;  // ...minus its time on the wire
+  uint32_t max_overhead_us;
+  uint64_t total_overhead_us;
+  // The overhead less the time spent raising and releasing DE, i.e. the
+  // wait for the UART and any preemption. 0 if the release overlapped
+  // the end of the frame.
+  uint32_t last_net_overhead_us;
+  uint32_t max_net_overhead_us;
+  uint64_t total_net_overhead_us;
+  // Time a RS485DriveEnable takes to switch DE, 0 for a plain pin
+  uint32_t switch_us;  // Smoothed
+  uint32_t min_switch_us;
+  uint32_t max_switch_us;
+  uint32_t switch_failures;
+};
+
+class RS485Port : public Stream {
+public:
+  RS485Port();
+
+  /**
+   * @brief Starts the UART and leaves the transceiver receiving.
+   *
+   * @param config A SERIAL_* frame format, e.g. SERIAL_8E1.
+   * @return true if the UART drives DE in hardware.
+   */
+  bool begin(HardwareSerial *uart,
+             uint32_t baud,
+             uint32_t config,
+             int8_t rx_pin,
+             int8_t tx_pin,
+             int8_t de_pin);
+
+  /**
+   * @brief Starts the UART with DE switched by a function, e.g. an
+   *        expander pin. Call once whatever drives DE is set up.
+   */
+  void begin(HardwareSerial *uart,
+             uint32_t baud,
+             uint32_t config,
+             int8_t rx_pin,
+             int8_t tx_pin,
+             RS485DriveEnable drive_enable,
+             void *context);
+
+  /**
+   * @brief Waits until the last byte has left the UART and DE has been
+   *        released.
+   */
+  void flush() override;
+
+  /**
+   * @brief Raises DE if the frame has not started yet, then queues the
+   *        bytes for the UART.
+   * @return 0 if DE could not be raised, nothing is sent then.
+   */
+  size_t write(uint8_t value) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  int available() override;
+  int read() override;
+  int peek() override;
+
+  bool hardwareDE();
+
+  RS485Stats stats();
+  void resetStats();
+
+private:
+  HardwareSerial *_uart;
+  int8_t _de_pin;
+  bool _hardware_de;
+  RS485DriveEnable _drive_enable;
+  void *_drive_enable_context;
+  // Time on the wire per byte: start, data, parity and stop bits
+  uint32_t _byte_ns;
+  // availableForWrite() of the idle UART, i.e. with the TX FIFO empty
+  int _tx_empty_space;
+
+  bool _transmitting;
+  uint32_t _tx_start_us;  // DE switching on
+  uint32_t _tx_bytes;
+  // Switch time of the last setDriveEnable(), and of this frame's raise
+  uint32_t _last_switch_us;
+  uint32_t _raise_us;
+
+  RS485Stats _stats;
+
+  void startUart(HardwareSerial *uart, uint32_t baud, uint32_t config, int8_t rx_pin, int8_t tx_pin);
+  bool setDriveEnable(bool high);
+  bool startFrame();
+};
+
+#endif
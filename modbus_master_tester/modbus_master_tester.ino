@@ -2,12 +2,16 @@
 #include <ModbusMaster.h>
 #include <HardwareSerial.h>
 #include "src/MAX7314/MAX7314.hpp"
-
-// I2C Comms
-const int8_t kSDA = 32;
-const int8_t kSCL = 33;
+#include "src/Board/BoardDescription.hpp"
+#include "src/I2CBus/I2CBus.hpp"
+#include "src/Telemetry/Telemetry.hpp"
+#include "src/Scheduler/Scheduler.hpp"
+#include "src/Pipeline/SpscQueue.hpp"
+#include "src/RS485/RS485Port.hpp"
 
 HardwareSerial uart2(2);
+// Drives the transceiver's DE, ModbusMaster talks through it
+RS485Port rs485;
 
 ModbusMaster node;
 
@@ -15,60 +19,313 @@ ModbusMaster node;
 MAX7314 expanderOne;
 MAX7314 expanderTwo;
 
-int de_pin = 13;
+// Both expanders run at 400 kHz, anything else at the 100 kHz default
+I2CBus i2c_bus;
+const uint32_t expander_clock_hz = 400000;
+
+
+// Results and input changes go out as binary frames,
+// see tools/telemetry_decode.py
+Telemetry telemetry;
+uint16_t last_inputs = 0;
+
+const uint8_t server_id = 1;
+const uint16_t register_address = 0;
+const uint16_t register_count = 2;
+
+// Each subsystem runs at its own rate instead of one delay() for all
+Scheduler scheduler;
+const uint32_t inputs_period_ms = 50;
+const uint32_t report_period_ms = 10000;
+
+/*
+  I2C runs in the bus task on core 0, telemetry on the loop task on
+  core 1. Wire is only used through i2c_bus, which serialises the tasks
+  that share it: the bus task, the I2C worker, and with
+  BOARD_RS485_DE_ON_EXPANDER the Modbus task switching DE through
+  setPinsFast(). Only loop() touches Serial, and results cross over in
+  bus_events and modbus_events.
+  Set dual_core to false to run the bus, Modbus and telemetry halves
+  from loop() for comparison.
+*/
+const bool dual_core = true;
+const uint8_t bus_core = 0;
+const uint32_t bus_stack_size = 4096;
+
+/*
+  ModbusMaster blocks until the response arrives or its fixed 2 s
+  timeout runs out, so Modbus polling has a scheduler and task of its
+  own, at the bus task's priority. The two time slice on core 0 and a
+  server that does not answer no longer holds up the inputs task. Only
+  this task touches uart2, and its results cross over in modbus_events.
+*/
+Scheduler modbus_scheduler;
+const uint32_t modbus_period_ms = 1000;
+const UBaseType_t bus_task_priority = 1;
+// Not above the bus task, and not down at the idle task's 0
+const UBaseType_t modbus_task_priority = 1;
+
+enum BusEventType {
+  BUS_MODBUS_RESULT,
+  BUS_GPIO_EVENT,
+  BUS_TASK_STATS,
+};
+
+struct BusEvent {
+  uint8_t type;
+  uint32_t queued_us;
+  // BUS_MODBUS_RESULT
+  uint8_t result;
+  uint8_t count;
+  uint16_t registers[register_count];
+  // BUS_GPIO_EVENT
+  uint16_t pins;
+  uint16_t changed;
+  // BUS_TASK_STATS
+  uint8_t task;
+  uint32_t runs;
+  uint32_t mean_us;
+  uint32_t max_us;
+  uint32_t misses;
+};
+
+typedef SpscQueue<BusEvent, 32> BusEventQueue;
+BusEventQueue bus_events;
+BusEventQueue modbus_events;
+
+// Time events spend in the queue, reported as task 0xFF
+const uint8_t queue_stats_id = 0xFF;
+uint32_t queue_events = 0;
+uint64_t queue_total_us = 0;
+uint32_t queue_max_us = 0;
+
+// RS485 turnaround, DE high time past the end of each frame, reported
+// as task 0xFE. DE switch time through the expander is task 0xFD, and
+// the turnaround net of it task 0xFB.
+const uint8_t rs485_stats_id = 0xFE;
+const uint8_t rs485_switch_stats_id = 0xFD;
+const uint8_t rs485_net_stats_id = 0xFB;
+// The Modbus polling task is 0xFC
+const uint8_t modbus_stats_id = 0xFC;
+
 // Example data
 // count = 0x02 : 1 3 0 0 0 2 196 11 0 137 251 63 0 0 0 0 0 0 0 0 23 52 13 128 160 33 251 63 0 0 0 0 255 255 63 179 100 72 8 64 48 56 8 64 48 8 6 0 36 165 8 128 16 34 251 63 1 0 0 0 102 20 0 0
 // count = 0x04 : 1 3 0 0 0 4 68 9 0 33 251 63 0 0 0 0 0 0 0 0 152 33 251 63 68 0 0 0 0 0 0 0 255 255 63 179 100 72 8 64 48 56 8 64 48 8 6 0 36 165 8 128 16 34 251 63 1 0 0 0 86 85 0 0
 
-void pre_transmission() {
-  // Serial.println("PRE TRANS");
-  digitalWrite(de_pin, HIGH);
-  delay(10);
-}
-
-void post_transmission() {
-  // Serial.println("POST TRANS");
-  digitalWrite(de_pin, LOW);
-  delay(10);
+bool expander_drive_enable(bool high, void *context) {
+  return expanderTwo.setPinsFast(kBoardRS485DEExpanderPin, high);
 }
 
 void setup() {
 
   Serial.begin(115200);
-  Wire.begin(kSDA, kSCL);
+  Wire.begin(BOARD_EXPANDER_SDA, BOARD_EXPANDER_SCL);
 
-  uart2.begin(19200, SERIAL_8E1, 16, 17);
-  // uart2.begin(19200, SERIAL_8N1, 16, 17);
+  i2c_bus.begin(&Wire);
+  i2c_bus.setDeviceClock(BOARD_EXPANDER_1_ADDRESS, expander_clock_hz);
+  i2c_bus.setDeviceClock(BOARD_EXPANDER_2_ADDRESS, expander_clock_hz);
+  // Runs the asynchronous expander reads
+  i2c_bus.startWorker(bus_core);
 
   // New lib
-  expanderOne.init(&Wire, 0x20, NULL, 0);
-  expanderOne.configurePins(0xFF00);
-  expanderTwo.init(&Wire, 0x24, NULL, 0);
-  expanderTwo.configurePins(0x0000);
+  // Pin roles and start-up levels are in src/Board/BoardDescription.hpp
+  expanderOne.init(&i2c_bus, BOARD_EXPANDER_1_ADDRESS, kExpander1Image);
+  expanderTwo.init(&i2c_bus, BOARD_EXPANDER_2_ADDRESS, kExpander2Image);
+
+#if BOARD_RS485_DE_ON_EXPANDER
+  rs485.begin(&uart2, 19200, SERIAL_8E1, 16, 17, expander_drive_enable, NULL);
+#else
+  rs485.begin(&uart2, 19200, SERIAL_8E1, 16, 17, BOARD_RS485_DE);
+  // rs485.begin(&uart2, 19200, SERIAL_8N1, 16, 17, BOARD_RS485_DE);
+#endif
 
-  expanderTwo.setPinsLow(STATIC_PIN2);
+  // DE follows the UART, no pre/post transmission callbacks needed
+  node.begin(server_id, rs485);
 
-  pinMode(de_pin, OUTPUT);
+  telemetry.begin(&Serial);
+  last_inputs = expanderOne.readPins();
 
-  node.begin(1, uart2);
-  node.preTransmission(pre_transmission);
-  node.postTransmission(post_transmission);
+  scheduler.add("inputs", poll_inputs, NULL, inputs_period_ms);
+  scheduler.add("report", report_tasks, NULL, report_period_ms);
+  modbus_scheduler.add("modbus", poll_modbus, NULL, modbus_period_ms);
+  modbus_scheduler.add("modbus_report", report_modbus, NULL, report_period_ms);
+
+  if (dual_core) {
+    xTaskCreatePinnedToCore(bus_task, "bus", bus_stack_size, NULL,
+                            bus_task_priority, NULL, bus_core);
+    xTaskCreatePinnedToCore(modbus_task, "modbus", bus_stack_size, NULL,
+                            modbus_task_priority, NULL, bus_core);
+  }
 }
 
 void loop() {
-  uint8_t result = node.readInputRegisters(0, 2);
-  Serial.print("RESULT: ");
-  Serial.println(result, HEX);
-  Serial.println();
-  delay(1000);
+  bool busy = false;
+  if (!dual_core) {
+    // The single threaded baseline, a silent server stalls everything
+    busy = scheduler.run();
+    busy |= modbus_scheduler.run();
+  }
+  busy |= send_events();
+  if (!busy) {
+    yield();
+  }
+}
+
+/*
+  Bus side. Must not touch Serial or telemetry.
+*/
+void bus_task(void *context) {
+  for (;;) {
+    if (!scheduler.run()) {
+      // Nothing due, give the core to the idle task
+      vTaskDelay(1);
+    }
+  }
+}
+
+void modbus_task(void *context) {
+  for (;;) {
+    if (!modbus_scheduler.run()) {
+      vTaskDelay(1);
+    }
+  }
+}
+
+void queue_event(BusEvent &event, BusEventQueue &queue = bus_events) {
+  event.queued_us = micros();
+  // A full queue drops the event, it is counted in queue.dropped()
+  queue.push(event);
+}
+
+void poll_modbus(void *context) {
+  BusEvent event = {};
+  event.type = BUS_MODBUS_RESULT;
+  event.result = node.readInputRegisters(register_address, register_count);
+  if (event.result == node.ku8MBSuccess) {
+    for (uint8_t i = 0; i < register_count; i++) {
+      event.registers[i] = node.getResponseBuffer(i);
+    }
+    event.count = register_count;
+  }
+  queue_event(event, modbus_events);
+}
+
+/*
+  Picks up the read started on the previous run and starts the next one,
+  so the bus task never waits on the expander.
+*/
+void poll_inputs(void *context) {
+  static bool read_started = false;
+  if (expanderOne.asyncBusy()) {
+    return;
+  }
+
+  uint16_t inputs;
+  if (read_started && expanderOne.asyncPins(&inputs) == I2C_OK && inputs != last_inputs) {
+    BusEvent event = {};
+    event.type = BUS_GPIO_EVENT;
+    event.pins = inputs;
+    event.changed = inputs ^ last_inputs;
+    queue_event(event);
+    last_inputs = inputs;
+  }
+  read_started = expanderOne.readPinsAsync();
+}
+
+void report_tasks(void *context) {
+  for (uint8_t i = 0; i < scheduler.taskCount(); i++) {
+    const SchedulerTaskStats &stats = scheduler.stats(i);
+    BusEvent event = {};
+    event.type = BUS_TASK_STATS;
+    event.task = i;
+    event.runs = stats.runs;
+    event.mean_us = stats.runs > 0 ? (uint32_t)(stats.total_us / stats.runs) : 0;
+    event.max_us = stats.max_us;
+    event.misses = stats.misses;
+    queue_event(event);
+  }
+}
+
+/*
+  Runs on the Modbus task, the only writer of these stats, so their
+  64 bit totals are never read half updated from another core.
+*/
+void report_modbus(void *context) {
+  const SchedulerTaskStats &modbus = modbus_scheduler.stats(0);
+  BusEvent event = {};
+  event.type = BUS_TASK_STATS;
+  event.task = modbus_stats_id;
+  event.runs = modbus.runs;
+  event.mean_us = modbus.runs > 0 ? (uint32_t)(modbus.total_us / modbus.runs) : 0;
+  event.max_us = modbus.max_us;
+  event.misses = modbus.misses;
+  queue_event(event, modbus_events);
+
+  RS485Stats bus = rs485.stats();
+  event.task = rs485_stats_id;
+  event.runs = bus.frames;
+  event.mean_us = bus.frames > 0 ? (uint32_t)(bus.total_overhead_us / bus.frames) : 0;
+  event.max_us = bus.max_overhead_us;
+  event.misses = bus.switch_failures;
+  queue_event(event, modbus_events);
+
+  if (BOARD_RS485_DE_ON_EXPANDER) {
+    event.task = rs485_switch_stats_id;
+    event.mean_us = bus.switch_us;
+    event.max_us = bus.max_switch_us;
+    queue_event(event, modbus_events);
+
+    event.task = rs485_net_stats_id;
+    event.mean_us = bus.frames > 0 ? (uint32_t)(bus.total_net_overhead_us / bus.frames) : 0;
+    event.max_us = bus.max_net_overhead_us;
+    queue_event(event, modbus_events);
+  }
+}
+
+/*
+  Application side, sends whatever the bus and Modbus tasks have produced.
+*/
+bool send_events() {
+  return send_queue(bus_events) | send_queue(modbus_events);
+}
+
+bool send_queue(BusEventQueue &queue) {
+  BusEvent event;
+  bool sent = false;
+
+  while (queue.pop(event)) {
+    uint32_t wait_us = micros() - event.queued_us;
+    queue_events++;
+    queue_total_us += wait_us;
+    if (wait_us > queue_max_us) {
+      queue_max_us = wait_us;
+    }
+
+    switch (event.type) {
+      case BUS_MODBUS_RESULT:
+        telemetry.modbusResult(server_id, 0x04, event.result, event.registers, event.count);
+        break;
+      case BUS_GPIO_EVENT:
+        telemetry.gpioEvent(BOARD_EXPANDER_1_ADDRESS, event.pins, event.changed);
+        break;
+      case BUS_TASK_STATS:
+        telemetry.taskStats(event.task, event.runs, event.mean_us, event.max_us, event.misses);
+        if (event.task == scheduler.taskCount() - 1) {
+          // Queue hop latency after the last task; misses are drops
+          telemetry.taskStats(queue_stats_id, queue_events,
+                              (uint32_t)(queue_total_us / queue_events),
+                              queue_max_us, bus_events.dropped() + modbus_events.dropped());
+        }
+        break;
+    }
+    sent = true;
+  }
+  return sent;
 }
 
 void test_uart() {
-  pre_transmission();
-  uart2.write('a');
-  delay(10);
-  post_transmission();
-  uart2.flush();
+  rs485.write('a');
+  rs485.flush();
   delay(1000);
 }
 
@@ -0,0 +1,286 @@
+/*
+  Shared I2C bus manager.
+
+  One I2CBus owns a TwoWire and hands it to one task at a time. Tasks
+  that find the bus busy wait in a queue ordered by priority, then by
+  arrival, and are woken with a task notification when it is their turn.
+  A task may nest transactions, e.g. a mux channel guard around a sensor
+  read, without deadlocking itself.
+
+  Each device address can have its own clock speed. The clock is only
+  changed when the next transaction is for a device with a different
+  one.
+
+  Drivers open a transaction with I2CTransaction. With no bus set it does
+  nothing, so drivers still work on a bare TwoWire.
+
+  startWorker() adds a task that runs I2CRequests submitted with
+  submit(). The caller gets control back at once and the request's
+  callback runs on the worker when the transfer is done, so a driver can
+  overlap bus time with other work. Worker requests take the bus like
+  any other transaction.
+
+  Drivers track whether their device answers with I2CDeviceHealth, so a
+  missing device fails at once instead of costing a NACK or timeout on
+  every access.
+*/
+
+#ifndef I2C_BUS_H
+#define I2C_BUS_H
+
+#include "Arduino.h"
+#include <Wire.h>
+
+// Tasks that can wait for the bus at the same time
+#define I2C_BUS_MAX_WAITERS 8
+// Devices with their own clock speed
+#define I2C_BUS_MAX_DEVICES 16
+// Requests the worker can have queued
+#define I2C_BUS_QUEUE_LENGTH 8
+#define I2C_BUS_WORKER_STACK 3072
+// Failed transfers in a row before a device is taken offline
+#define I2C_HEALTH_FAIL_LIMIT 3
+// Wait before re-probing an offline device, doubled after every failed probe
+#define I2C_HEALTH_RETRY_MIN_MS 100
+#define I2C_HEALTH_RETRY_MAX_MS 5000
+
+/**
+ * @brief Writes a register address, then reads from it after a repeated
+ *        START, with no STOP in between. This saves a STOP/START pair
+ *        and a separate transfer per register read, and no other
+ *        master can claim the bus between the two halves.
+ *
+ * @return Number of bytes read into out, 0 if the device did not
+ *         acknowledge the register address.
+ */
+uint8_t i2cWriteRead(TwoWire *i2c_interface,
+                     uint8_t address,
+                     uint8_t reg,
+                     uint8_t *out,
+                     uint8_t length);
+
+enum I2CPriority {
+  I2C_PRIORITY_LOW = 0,
+  I2C_PRIORITY_NORMAL = 1,
+  I2C_PRIORITY_HIGH = 2,
+};
+
+enum I2CStatus {
+  I2C_OK = 0,
+  I2C_PENDING,     // Submitted, not finished yet
+  I2C_NACK,        // Address or data not acknowledged
+  I2C_SHORT_READ,  // Fewer bytes than asked for
+  I2C_QUEUE_FULL,  // Not submitted
+  I2C_OFFLINE,     // Device offline, nothing was sent
+};
+
+/*
+  Presence of one device, driven by the results of its transfers.
+
+  After I2C_HEALTH_FAIL_LIMIT failures in a row the device goes offline
+  and ready() turns false, so drivers can fail straight away. Once the
+  retry wait has passed ready() lets transfers through again as a probe.
+  A failed probe doubles the wait, up to I2C_HEALTH_RETRY_MAX_MS, and one
+  success brings the device back online.
+
+  Health belongs to the driver rather than the bus, since devices behind
+  a mux share an address.
+*/
+class I2CDeviceHealth {
+public:
+  I2CDeviceHealth();
+
+  /**
+   * @brief true if the device is online or due to be probed again.
+   */
+  bool ready();
+
+  /**
+   * @brief Records the result of a transfer with the device.
+   */
+  void record(bool ok);
+
+  bool online();
+
+  /**
+   * @brief Failed transfers since the last success.
+   */
+  uint8_t failures();
+
+  /**
+   * @brief Times the device has gone offline.
+   */
+  uint32_t dropouts();
+
+  /**
+   * @brief Counts a reading the driver dropped because the device did
+   *        not deliver it.
+   */
+  void skip();
+
+  /**
+   * @brief Readings dropped so far.
+   */
+  uint32_t skipped();
+
+private:
+  bool _online;
+  uint8_t _failures;
+  uint32_t _dropouts;
+  uint32_t _skipped;
+  uint32_t _retry_at_ms;
+  uint32_t _retry_wait_ms;
+};
+
+struct I2CRequest;
+typedef void (*I2CCallback)(I2CRequest *request);
+
+/*
+  One asynchronous transfer: writes tx_length bytes, then reads
+  rx_length bytes after a repeated START. Either length may be 0. The
+  buffers and the request itself must stay valid until it completes.
+*/
+struct I2CRequest {
+  uint8_t address;
+  const uint8_t *tx;
+  uint8_t tx_length;
+  uint8_t *rx;
+  uint8_t rx_length;
+  uint8_t priority;
+  // Runs on the worker task, may be NULL
+  I2CCallback callback;
+  void *context;
+  // Checked before and updated after the transfer, may be NULL
+  I2CDeviceHealth *health;
+
+  // Set on completion
+  volatile uint8_t status;
+  uint8_t rx_received;
+};
+
+struct I2CBusStats {
+  uint32_t transactions;
+  uint32_t contended;  // Transactions that had to wait
+  uint32_t total_wait_us;
+  uint32_t max_wait_us;
+  uint8_t max_depth;  // Most tasks waiting at once
+  uint32_t clock_changes;
+};
+
+class I2CBus {
+public:
+  I2CBus();
+
+  /**
+   * @brief Takes ownership of an initialized TwoWire.
+   *
+   * @param default_clock_hz Clock for devices without their own.
+   */
+  void begin(TwoWire *i2c_interface, uint32_t default_clock_hz = 100000);
+
+  /**
+   * @brief Sets the clock used for transactions with a device.
+   *
+   * @return false if the device table is full.
+   */
+  bool setDeviceClock(uint8_t address, uint32_t clock_hz);
+
+  /**
+   * @brief Waits until the calling task owns the bus and applies the
+   *        device's clock. Every acquire() needs a release().
+   */
+  TwoWire *acquire(uint8_t address, uint8_t priority = I2C_PRIORITY_NORMAL);
+  void release();
+
+  TwoWire *wire();
+
+  /**
+   * @brief Starts the task that runs submitted requests.
+   *
+   * @return false if the queue or task could not be created.
+   */
+  bool startWorker(uint8_t core, uint8_t task_priority = 2);
+
+  /**
+   * @brief Queues a request for the worker. Never blocks.
+   *
+   * @return false, with status I2C_QUEUE_FULL or I2C_OFFLINE, if it was
+   *         not queued.
+   */
+  bool submit(I2CRequest *request);
+
+  /**
+   * @brief Runs a request on the calling task, e.g. when there is no
+   *        worker, and calls its callback. A request for an offline
+   *        device completes at once with I2C_OFFLINE.
+   */
+  void execute(I2CRequest *request);
+
+  /**
+   * @brief i2cWriteRead() as a single transaction on this bus.
+   */
+  uint8_t writeRead(uint8_t address,
+                    uint8_t reg,
+                    uint8_t *out,
+                    uint8_t length,
+                    uint8_t priority = I2C_PRIORITY_NORMAL);
+
+  /**
+   * @brief Tasks currently waiting for the bus.
+   */
+  uint8_t depth();
+
+  I2CBusStats stats();
+  void resetStats();
+
+private:
+  struct Waiter {
+    TaskHandle_t task;
+    uint8_t priority;
+  };
+
+  struct DeviceClock {
+    uint8_t address;
+    uint32_t clock_hz;
+  };
+
+  TwoWire *_i2c_interface;
+  uint32_t _default_clock_hz;
+  uint32_t _clock_hz;
+
+  DeviceClock _devices[I2C_BUS_MAX_DEVICES];
+  uint8_t _device_count;
+
+  portMUX_TYPE _lock;
+  TaskHandle_t _owner;
+  uint8_t _nesting;
+  Waiter _waiters[I2C_BUS_MAX_WAITERS];
+  uint8_t _waiter_count;
+
+  I2CBusStats _stats;
+
+  QueueHandle_t _requests;
+
+  uint32_t clockFor(uint8_t address);
+  void transfer(I2CRequest *request);
+  static void worker(void *bus);
+};
+
+/*
+  Holds the bus for one transaction, or a group of them that must not be
+  interleaved with other tasks, for the lifetime of the object.
+*/
+class I2CTransaction {
+public:
+  I2CTransaction(I2CBus *bus, uint8_t address, uint8_t priority = I2C_PRIORITY_NORMAL);
+  ~I2CTransaction();
+
+private:
+  I2CBus *_bus;
+
+  // Transactions are scoped, never copied
+  I2CTransaction(const I2CTransaction &);
+  I2CTransaction &operator=(const I2CTransaction &);
+};
+
+#endif
@@ -0,0 +1,90 @@
+/*
+  Bounded lock-free queue for one producer and one consumer.
+
+  Used to pass work between the two ESP32 cores without a mutex: the
+  producer only writes _head, the consumer only writes _tail, and the
+  acquire/release pair on each index publishes the slot contents.
+  Items are copied in and out, nothing is allocated. When the queue is
+  full push() fails and the drop is counted, the producer never waits.
+
+  Only std::atomic is used, so the queue also builds on a host with
+  std::thread standing in for the two cores.
+*/
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdint.h>
+#include <atomic>
+
+template<typename T, uint16_t N>
+class SpscQueue {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+  SpscQueue()
+    : _head(0), _tail(0), _dropped(0), _high_water(0) {}
+
+  /**
+   * @brief Copies an item in. Producer only.
+   *
+   * @return false if the queue was full and the item was dropped.
+   */
+  bool push(const T &item) {
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    uint32_t depth = head - _tail.load(std::memory_order_acquire);
+    if (depth >= N) {
+      _dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    _items[head & (N - 1)] = item;
+    _head.store(head + 1, std::memory_order_release);
+
+    if (depth + 1 > _high_water.load(std::memory_order_relaxed)) {
+      _high_water.store(depth + 1, std::memory_order_relaxed);
+    }
+    return true;
+  }
+
+  /**
+   * @brief Copies the oldest item out. Consumer only.
+   *
+   * @return false if the queue was empty.
+   */
+  bool pop(T &item) {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    item = _items[tail & (N - 1)];
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Items waiting. Exact from either side, approximate elsewhere.
+   */
+  uint16_t depth() const {
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+  }
+
+  uint32_t dropped() const {
+    return _dropped.load(std::memory_order_relaxed);
+  }
+
+  uint16_t highWater() const {
+    return _high_water.load(std::memory_order_relaxed);
+  }
+
+private:
+  T _items[N];
+  // Free running counters, the slot is the counter mod N
+  std::atomic<uint32_t> _head;
+  std::atomic<uint32_t> _tail;
+  std::atomic<uint32_t> _dropped;
+  std::atomic<uint16_t> _high_water;
+};
+
+#endif
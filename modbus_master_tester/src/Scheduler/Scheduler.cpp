@@ -0,0 +1,185 @@
+#include "Scheduler.hpp"
+
+Scheduler::Scheduler() {
+  _task_count = 0;
+  _wheel_ms = millis();
+  _ready_head = 0;
+  _ready_count = 0;
+  for (uint8_t i = 0; i < SCHEDULER_WHEEL_SLOTS; i++) {
+    _wheel[i] = _kNone;
+  }
+}
+
+int8_t Scheduler::add(const char *name,
+                      SchedulerTask task,
+                      void *context,
+                      uint32_t period_ms,
+                      uint32_t deadline_ms) {
+  if (_task_count >= SCHEDULER_MAX_TASKS) {
+    return _kNone;
+  }
+
+  int8_t id = _task_count++;
+  Task &t = _tasks[id];
+  t.function = task;
+  t.context = context;
+  t.deadline_ms = deadline_ms > 0 ? deadline_ms : period_ms;
+  t.next = _kNone;
+  t.queued = false;
+  memset(&t.stats, 0, sizeof(t.stats));
+  t.stats.name = name;
+  t.stats.period_ms = period_ms;
+
+  // Periodic tasks start right away
+  if (period_ms > 0) {
+    t.due_ms = millis();
+    pushReady(id);
+  }
+  return id;
+}
+
+void Scheduler::trigger(int8_t id) {
+  if (id < 0 || id >= _task_count) {
+    return;
+  }
+  Task &t = _tasks[id];
+  if (t.queued && !unlink(id)) {
+    // Already in the ready queue
+    return;
+  }
+  t.due_ms = millis();
+  pushReady(id);
+}
+
+bool Scheduler::run() {
+  uint32_t now = millis();
+  advance(now);
+
+  if (_ready_count == 0) {
+    return false;
+  }
+
+  int8_t id = _ready[_ready_head];
+  _ready_head = (_ready_head + 1) % SCHEDULER_MAX_TASKS;
+  _ready_count--;
+
+  Task &t = _tasks[id];
+  t.queued = false;
+
+  uint32_t late_ms = now - t.due_ms;
+  if (late_ms > t.stats.max_late_ms) {
+    t.stats.max_late_ms = late_ms;
+  }
+  if (late_ms > t.deadline_ms) {
+    t.stats.misses++;
+  }
+
+  uint32_t start_us = micros();
+  t.function(t.context);
+  uint32_t run_us = micros() - start_us;
+
+  t.stats.runs++;
+  t.stats.last_us = run_us;
+  t.stats.total_us += run_us;
+  if (run_us > t.stats.max_us) {
+    t.stats.max_us = run_us;
+  }
+
+  if (t.stats.period_ms > 0 && !t.queued) {
+    // Keep a fixed rate, but don't queue a burst to catch up
+    t.due_ms += t.stats.period_ms;
+    now = millis();
+    if ((int32_t)(now - t.due_ms) > 0) {
+      t.due_ms = now;
+    }
+    insert(id);
+  }
+  return true;
+}
+
+uint8_t Scheduler::taskCount() {
+  return _task_count;
+}
+
+const SchedulerTaskStats &Scheduler::stats(int8_t id) {
+  return _tasks[id].stats;
+}
+
+void Scheduler::resetStats() {
+  for (uint8_t i = 0; i < _task_count; i++) {
+    SchedulerTaskStats &s = _tasks[i].stats;
+    s.runs = 0;
+    s.last_us = 0;
+    s.max_us = 0;
+    s.total_us = 0;
+    s.misses = 0;
+    s.max_late_ms = 0;
+  }
+}
+
+void Scheduler::report(Print &out) {
+  for (uint8_t i = 0; i < _task_count; i++) {
+    const SchedulerTaskStats &s = _tasks[i].stats;
+    out.printf("TASK %-10s every %5u ms: runs %u mean %u us max %u us missed %u (max late %u ms)\n",
+               s.name, s.period_ms, s.runs,
+               s.runs > 0 ? (uint32_t)(s.total_us / s.runs) : 0,
+               s.max_us, s.misses, s.max_late_ms);
+  }
+}
+
+void Scheduler::insert(int8_t id) {
+  Task &t = _tasks[id];
+  if ((int32_t)(t.due_ms - _wheel_ms) <= 0) {
+    // Its slot has already been passed this lap
+    pushReady(id);
+    return;
+  }
+  uint8_t slot = t.due_ms & (SCHEDULER_WHEEL_SLOTS - 1);
+  t.next = _wheel[slot];
+  t.queued = true;
+  _wheel[slot] = id;
+}
+
+bool Scheduler::unlink(int8_t id) {
+  uint8_t slot = _tasks[id].due_ms & (SCHEDULER_WHEEL_SLOTS - 1);
+  int8_t *link = &_wheel[slot];
+  while (*link != _kNone) {
+    if (*link == id) {
+      *link = _tasks[id].next;
+      _tasks[id].queued = false;
+      return true;
+    }
+    link = &_tasks[*link].next;
+  }
+  return false;
+}
+
+void Scheduler::pushReady(int8_t id) {
+  _tasks[id].queued = true;
+  _ready[(_ready_head + _ready_count) % SCHEDULER_MAX_TASKS] = id;
+  _ready_count++;
+}
+
+void Scheduler::advance(uint32_t now_ms) {
+  // One slot per elapsed millisecond, at most one full lap
+  uint32_t elapsed = now_ms - _wheel_ms;
+  if (elapsed > SCHEDULER_WHEEL_SLOTS) {
+    elapsed = SCHEDULER_WHEEL_SLOTS;
+  }
+
+  for (uint32_t n = 1; n <= elapsed; n++) {
+    uint8_t slot = (_wheel_ms + n) & (SCHEDULER_WHEEL_SLOTS - 1);
+    int8_t *link = &_wheel[slot];
+    while (*link != _kNone) {
+      int8_t id = *link;
+      if ((int32_t)(now_ms - _tasks[id].due_ms) >= 0) {
+        *link = _tasks[id].next;
+        pushReady(id);
+      } else {
+        // Due on a later lap
+        link = &_tasks[id].next;
+      }
+    }
+  }
+  _wheel_ms = now_ms;
+}
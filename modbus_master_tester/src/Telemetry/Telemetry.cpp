@@ -0,0 +1,149 @@
+#include "Telemetry.hpp"
+
+Telemetry::Telemetry() {
+  _out = NULL;
+  _sequence = 0;
+  _frames_sent = 0;
+  _bytes_sent = 0;
+}
+
+void Telemetry::begin(Print *out) {
+  _out = out;
+  // Ends whatever the receiver has buffered, e.g. boot text
+  _out->write((uint8_t)0x00);
+}
+
+bool Telemetry::sample(uint8_t sensor, int32_t milli_c) {
+  uint8_t i = beginRecord(TELEMETRY_SAMPLE);
+  _record[i++] = sensor;
+  i = put32(_record, i, (uint32_t)milli_c);
+  return send(i);
+}
+
+bool Telemetry::modbusResult(uint8_t server_id,
+                             uint8_t function_code,
+                             uint8_t result,
+                             const uint16_t *registers,
+                             uint8_t count) {
+  if (count > TELEMETRY_MAX_REGISTERS) {
+    count = TELEMETRY_MAX_REGISTERS;
+  }
+
+  uint8_t i = beginRecord(TELEMETRY_MODBUS_RESULT);
+  _record[i++] = server_id;
+  _record[i++] = function_code;
+  _record[i++] = result;
+  _record[i++] = count;
+  for (uint8_t r = 0; r < count; r++) {
+    i = put16(_record, i, registers[r]);
+  }
+  return send(i);
+}
+
+bool Telemetry::gpioEvent(uint8_t device, uint16_t pins, uint16_t changed) {
+  uint8_t i = beginRecord(TELEMETRY_GPIO_EVENT);
+  _record[i++] = device;
+  i = put16(_record, i, pins);
+  i = put16(_record, i, changed);
+  return send(i);
+}
+
+bool Telemetry::taskStats(uint8_t task,
+                          uint32_t runs,
+                          uint32_t mean_us,
+                          uint32_t max_us,
+                          uint32_t misses) {
+  uint8_t i = beginRecord(TELEMETRY_TASK_STATS);
+  _record[i++] = task;
+  i = put32(_record, i, runs);
+  i = put32(_record, i, mean_us);
+  i = put32(_record, i, max_us);
+  i = put32(_record, i, misses);
+  return send(i);
+}
+
+uint32_t Telemetry::framesSent() {
+  return _frames_sent;
+}
+
+uint32_t Telemetry::bytesSent() {
+  return _bytes_sent;
+}
+
+uint8_t Telemetry::beginRecord(TelemetryRecordType type) {
+  _record[0] = type;
+  _record[1] = _sequence++;
+  return put32(_record, 2, millis());
+}
+
+bool Telemetry::send(uint8_t length) {
+  if (_out == NULL) {
+    return false;
+  }
+
+  length = put16(_record, length, crc16(_record, length));
+  uint8_t frame_length = cobsEncode(_record, length, _frame);
+  _frame[frame_length++] = 0x00;
+
+  // One block write instead of a print per field
+  size_t written = _out->write(_frame, frame_length);
+  _bytes_sent += written;
+  if (written != frame_length) {
+    return false;
+  }
+  _frames_sent++;
+  return true;
+}
+
+uint8_t Telemetry::put16(uint8_t *buffer, uint8_t index, uint16_t value) {
+  buffer[index++] = lowByte(value);
+  buffer[index++] = highByte(value);
+  return index;
+}
+
+uint8_t Telemetry::put32(uint8_t *buffer, uint8_t index, uint32_t value) {
+  index = put16(buffer, index, value & 0xFFFF);
+  return put16(buffer, index, value >> 16);
+}
+
+// CRC-16/MODBUS, the same CRC the RS485 side already uses
+uint16_t Telemetry::crc16(const uint8_t *buffer, uint8_t length) {
+  uint16_t crc = 0xFFFF;
+  for (uint8_t pos = 0; pos < length; pos++) {
+    crc ^= buffer[pos];
+    for (uint8_t i = 0; i < 8; i++) {
+      if (crc & 0x0001) {
+        crc = (crc >> 1) ^ 0xA001;
+      } else {
+        crc >>= 1;
+      }
+    }
+  }
+  return crc;
+}
+
+// Consistent Overhead Byte Stuffing: removes every 0x00 from the data so
+// 0x00 can delimit frames
+uint8_t Telemetry::cobsEncode(const uint8_t *in, uint8_t length, uint8_t *out) {
+  uint8_t out_index = 1;
+  uint8_t code_index = 0;
+  uint8_t code = 1;
+
+  for (uint8_t i = 0; i < length; i++) {
+    if (in[i] == 0x00) {
+      out[code_index] = code;
+      code_index = out_index++;
+      code = 1;
+      continue;
+    }
+    out[out_index++] = in[i];
+    code++;
+    if (code == 0xFF) {
+      out[code_index] = code;
+      code_index = out_index++;
+      code = 1;
+    }
+  }
+  out[code_index] = code;
+  return out_index;
+}
@@ -22,9 +22,9 @@ void setup() {
 void loop() {
 
   send_mode();
-  delay(5);
   uart2.write('a');
-  delay(5);
+  // Returns once the stop bit is out, release the line right away
+  uart2.flush();
   receive_mode();
   delay(500);
 
@@ -26,7 +26,8 @@ void loop() {
     Serial.println(input);
     send_mode();
     uart2.write('b');
-    delay(10);
+    // Returns once the stop bit is out, release the line right away
+    uart2.flush();
     receive_mode();
   }
 
@@ -0,0 +1,32 @@
+#include "Board.hpp"
+
+bool Board::begin() {
+  bool ok = true;
+
+  for (uint8_t b = 0; b < BOARD_BUS_COUNT; b++) {
+    const BoardBusConfig &config = kBoardBuses[b];
+    TwoWire *i2c_interface = config.controller == 0 ? &Wire : &Wire1;
+    ok &= i2c_interface->begin(config.sda, config.scl);
+
+    _buses[b].begin(i2c_interface, config.clock_hz);
+    for (uint8_t d = 0; d < BOARD_DEVICE_COUNT; d++) {
+      if (kBoardDevices[d].bus == b) {
+        _buses[b].setDeviceClock(kBoardDevices[d].address, kBoardDevices[d].clock_hz);
+      }
+    }
+    ok &= _buses[b].startWorker(config.worker_core);
+  }
+  return ok;
+}
+
+I2CBus *Board::busFor(BoardDevice device) {
+  return &_buses[kBoardDevices[device].bus];
+}
+
+uint8_t Board::address(BoardDevice device) {
+  return kBoardDevices[device].address;
+}
+
+I2CBus *Board::bus(BoardBus bus) {
+  return &_buses[bus];
+}
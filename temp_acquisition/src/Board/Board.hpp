@@ -0,0 +1,89 @@
+/*
+  Board wiring for the I2C devices.
+
+  The board has two I2C buses on separate pins: the GPIO expanders on
+  one, the mux and temperature sensors on the other. Each bus gets one
+  of the ESP32's two I2C controllers (Wire and Wire1) and its own I2CBus
+  with its own worker task and request queue, so expander traffic never
+  waits behind a sensor read and the two run in parallel.
+
+  To move a device to the other bus, change its entry in kBoardDevices.
+*/
+
+#ifndef BOARD_H
+#define BOARD_H
+
+#include "Arduino.h"
+#include <Wire.h>
+#include "../I2CBus/I2CBus.hpp"
+#include "BoardDescription.hpp"
+
+enum BoardBus {
+  BOARD_BUS_EXPANDERS,
+  BOARD_BUS_SENSORS,
+  BOARD_BUS_COUNT,
+};
+
+enum BoardDevice {
+  BOARD_EXPANDER_1,
+  BOARD_EXPANDER_2,
+  BOARD_MUX,
+  BOARD_TSYS01,
+  BOARD_DEVICE_COUNT,
+};
+
+struct BoardBusConfig {
+  uint8_t controller;  // 0 = Wire, 1 = Wire1
+  int8_t sda;
+  int8_t scl;
+  uint32_t clock_hz;  // For devices without their own
+  uint8_t worker_core;
+};
+
+struct BoardDeviceConfig {
+  uint8_t bus;
+  uint8_t address;
+  uint32_t clock_hz;
+};
+
+static const BoardBusConfig kBoardBuses[BOARD_BUS_COUNT] = {
+  // BOARD_BUS_EXPANDERS
+  { 0, BOARD_EXPANDER_SDA, BOARD_EXPANDER_SCL, 100000, 0 },
+  // BOARD_BUS_SENSORS
+  { 1, BOARD_SENSOR_SDA, BOARD_SENSOR_SCL, 100000, 1 },
+};
+
+static const BoardDeviceConfig kBoardDevices[BOARD_DEVICE_COUNT] = {
+  // BOARD_EXPANDER_1: inputs, PWM and GPIO outputs
+  { BOARD_BUS_EXPANDERS, BOARD_EXPANDER_1_ADDRESS, 400000 },
+  // BOARD_EXPANDER_2: GPIO outputs
+  { BOARD_BUS_EXPANDERS, BOARD_EXPANDER_2_ADDRESS, 400000 },
+  // BOARD_MUX: TCA9548A
+  { BOARD_BUS_SENSORS, BOARD_MUX_ADDRESS, 400000 },
+  // BOARD_TSYS01: every TSYS01, told apart by mux channel
+  { BOARD_BUS_SENSORS, BOARD_TSYS01_ADDRESS, 400000 },
+};
+
+class Board {
+public:
+  /**
+   * @brief Starts both I2C controllers on their pins, applies the
+   *        device clocks and starts each bus worker.
+   *
+   * @return false if a bus failed to start.
+   */
+  bool begin();
+
+  /**
+   * @brief The bus manager a device is on.
+   */
+  I2CBus *busFor(BoardDevice device);
+  uint8_t address(BoardDevice device);
+
+  I2CBus *bus(BoardBus bus);
+
+private:
+  I2CBus _buses[BOARD_BUS_COUNT];
+};
+
+#endif
@@ -0,0 +1,128 @@
+#include "BootSequencer.hpp"
+
+BootSequencer::BootSequencer() {
+  _count = 0;
+  _elapsed_us = 0;
+}
+
+int8_t BootSequencer::add(const char *name, const BootStep *steps, uint8_t count, void *context) {
+  if (_count >= BOOT_MAX_SUBSYSTEMS) {
+    return -1;
+  }
+
+  Subsystem &subsystem = _subsystems[_count];
+  subsystem.steps = steps;
+  subsystem.count = count;
+  subsystem.context = context;
+  subsystem.next = 0;
+  subsystem.ready_at_us = 0;
+  subsystem.done = count == 0;
+
+  BootSubsystemStats &stats = _stats[_count];
+  stats.name = name;
+  stats.done_us = 0;
+  stats.busy_us = 0;
+  stats.wait_us = 0;
+  stats.failed_step = NULL;
+
+  return _count++;
+}
+
+bool BootSequencer::run() {
+  uint32_t start_us = micros();
+  for (uint8_t i = 0; i < _count; i++) {
+    _subsystems[i].ready_at_us = start_us;
+  }
+
+  bool ok = true;
+  for (;;) {
+    bool pending = false;
+    bool ran = false;
+    for (uint8_t i = 0; i < _count; i++) {
+      Subsystem &subsystem = _subsystems[i];
+      if (subsystem.done) {
+        continue;
+      }
+      pending = true;
+      if ((int32_t)(micros() - subsystem.ready_at_us) < 0) {
+        continue;
+      }
+
+      if (subsystem.next == subsystem.count) {
+        // The last wait has passed
+        subsystem.done = true;
+        _stats[i].done_us = micros() - start_us;
+        continue;
+      }
+      ok &= step(i, start_us);
+      ran = true;
+    }
+    if (!pending) {
+      break;
+    }
+    if (!ran) {
+      // Every subsystem is waiting
+      yield();
+    }
+  }
+
+  _elapsed_us = micros() - start_us;
+  return ok;
+}
+
+uint32_t BootSequencer::elapsedUs() {
+  return _elapsed_us;
+}
+
+uint32_t BootSequencer::sequentialUs() {
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < _count; i++) {
+    total += _stats[i].busy_us + _stats[i].wait_us;
+  }
+  return total;
+}
+
+uint8_t BootSequencer::subsystemCount() {
+  return _count;
+}
+
+const BootSubsystemStats &BootSequencer::stats(int8_t id) {
+  return _stats[id];
+}
+
+void BootSequencer::report(Print &out) {
+  for (uint8_t i = 0; i < _count; i++) {
+    const BootSubsystemStats &stats = _stats[i];
+    out.printf("BOOT %-10s up at %7u us  busy %7u us  wait %7u us",
+               stats.name, stats.done_us, stats.busy_us, stats.wait_us);
+    if (stats.failed_step != NULL) {
+      out.printf("  FAILED at %s", stats.failed_step);
+    }
+    out.println();
+  }
+  out.printf("BOOT total %u us, %u us in sequence\n", _elapsed_us, sequentialUs());
+}
+
+bool BootSequencer::step(uint8_t id, uint32_t start_us) {
+  Subsystem &subsystem = _subsystems[id];
+  BootSubsystemStats &stats = _stats[id];
+  const BootStep &step = subsystem.steps[subsystem.next];
+
+  uint32_t step_start_us = micros();
+  bool ok = step.run(subsystem.context);
+  uint32_t step_end_us = micros();
+  stats.busy_us += step_end_us - step_start_us;
+
+  if (!ok) {
+    // Later steps depend on this one, give up on the subsystem
+    subsystem.done = true;
+    stats.failed_step = step.name;
+    stats.done_us = step_end_us - start_us;
+    return false;
+  }
+
+  subsystem.next++;
+  subsystem.ready_at_us = step_end_us + step.wait_us;
+  stats.wait_us += step.wait_us;
+  return true;
+}
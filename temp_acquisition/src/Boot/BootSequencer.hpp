@@ -0,0 +1,97 @@
+/*
+  Startup sequencer.
+
+  Each subsystem declares its init steps in order, with the time it
+  needs after each step before the next one, e.g. a sensor's reset wait.
+  run() interleaves the subsystems: whenever one is waiting, the next
+  step of any other subsystem that is ready runs instead of a delay().
+  A step that fails ends its subsystem, the others carry on.
+
+  The sequencer times every subsystem, so report() shows when each one
+  came up and how long the same steps would have taken in sequence.
+*/
+
+#ifndef BOOT_SEQUENCER_H
+#define BOOT_SEQUENCER_H
+
+#include "Arduino.h"
+
+#define BOOT_MAX_SUBSYSTEMS 8
+
+typedef bool (*BootStepFunction)(void *context);
+
+struct BootStep {
+  const char *name;
+  BootStepFunction run;
+  // Time the subsystem needs after this step before the next one
+  uint32_t wait_us;
+};
+
+struct BootSubsystemStats {
+  const char *name;
+  uint32_t done_us;  // From the start of run() to the end of the last wait
+  uint32_t busy_us;  // Spent in the steps themselves
+  uint32_t wait_us;  // Declared waits
+  // Step that failed, or NULL
+  const char *failed_step;
+};
+
+class BootSequencer {
+public:
+  BootSequencer();
+
+  /**
+   * @brief Registers a subsystem.
+   *
+   * @param name A string literal, used in reports.
+   * @param steps Steps in order. The array must outlive run().
+   * @param context Passed to every step.
+   * @return The subsystem id, or -1 if the table is full.
+   */
+  int8_t add(const char *name, const BootStep *steps, uint8_t count, void *context);
+
+  /**
+   * @brief Runs every step of every subsystem and returns once the last
+   *        wait has passed.
+   *
+   * @return false if any step failed.
+   */
+  bool run();
+
+  /**
+   * @brief Duration of run().
+   */
+  uint32_t elapsedUs();
+
+  /**
+   * @brief Duration of the same steps and waits run one after another.
+   */
+  uint32_t sequentialUs();
+
+  uint8_t subsystemCount();
+  const BootSubsystemStats &stats(int8_t id);
+
+  /**
+   * @brief Prints one line per subsystem and the totals.
+   */
+  void report(Print &out);
+
+private:
+  struct Subsystem {
+    const BootStep *steps;
+    uint8_t count;
+    void *context;
+    uint8_t next;
+    uint32_t ready_at_us;
+    bool done;
+  };
+
+  Subsystem _subsystems[BOOT_MAX_SUBSYSTEMS];
+  BootSubsystemStats _stats[BOOT_MAX_SUBSYSTEMS];
+  uint8_t _count;
+  uint32_t _elapsed_us;
+
+  bool step(uint8_t id, uint32_t start_us);
+};
+
+#endif
@@ -0,0 +1,283 @@
+#include "ds18b20_bus.h"
+
+DS18B20_Bus::DS18B20_Bus() {
+  _one_wire = NULL;
+  _nvs_namespace = NULL;
+  _resolution = DS18B20_RESOLUTION_12_BIT;
+  _parasite = false;
+  _state = IDLE;
+  _conv_start_ms = 0;
+  _read_index = 0;
+  _count = 0;
+  _rescan_pending = false;
+  _scan_count = 0;
+}
+
+uint8_t DS18B20_Bus::begin(OneWire *one_wire,
+                           DS18B20_Resolution resolution,
+                           const char *nvs_namespace) {
+  _one_wire = one_wire;
+  _nvs_namespace = nvs_namespace;
+  _state = IDLE;
+  _scan_count = 0;
+
+  // Only search the bus if nothing usable was saved
+  if (!loadRoms()) {
+    rescan();
+  }
+  resetReadings();
+
+  // Any parasite powered sensor pulls the bus low during this read slot
+  _one_wire->reset();
+  _one_wire->skip();
+  _one_wire->write(READ_POWER_SUPPLY);
+  _parasite = (_one_wire->read_bit() == 0);
+
+  setResolution(resolution);
+  return _count;
+}
+
+uint8_t DS18B20_Bus::rescan() {
+  if (_state != IDLE) {
+    return _count;
+  }
+
+  uint8_t rom[_kRomSize];
+  _count = 0;
+  _one_wire->reset_search();
+  while (_count < DS18B20_MAX_DEVICES && _one_wire->search(rom)) {
+    if (!romValid(rom)) {
+      continue;
+    }
+    memcpy(_roms[_count], rom, _kRomSize);
+    _count++;
+  }
+
+  _scan_count++;
+  _rescan_pending = false;
+  resetReadings();
+  if (_count > 0) {
+    // Keep the last good list if the bus is down right now
+    saveRoms();
+  }
+  return _count;
+}
+
+bool DS18B20_Bus::setResolution(DS18B20_Resolution resolution) {
+  if (_state != IDLE) {
+    return false;
+  }
+  _resolution = resolution;
+
+  // The config byte holds R1:R0 in bits 6:5, the rest read as 1
+  uint8_t config = ((resolution - DS18B20_RESOLUTION_9_BIT) << 5) | 0x1F;
+  bool ok = true;
+  for (uint8_t i = 0; i < _count; i++) {
+    // The EEPROM takes a limited number of writes, so sensors already
+    // at this resolution are left alone. The scratchpad config is what
+    // the sensor loaded from EEPROM at power-up, or was copied there.
+    uint8_t scratchpad[_kScratchpadSize];
+    if (fetchScratchpad(i, scratchpad) && scratchpad[_kConfigIndex] == config) {
+      continue;
+    }
+    ok &= writeConfig(i, config);
+  }
+  return ok;
+}
+
+uint32_t DS18B20_Bus::conversionTimeMs() {
+  // 93.75 ms at 9 bit, doubling with each extra bit
+  return (750UL >> (DS18B20_RESOLUTION_12_BIT - _resolution)) + 1;
+}
+
+bool DS18B20_Bus::startConversion() {
+  if (_state != IDLE) {
+    return false;
+  }
+  if (_rescan_pending) {
+    // A rescan may find sensors that were swapped or came back, so
+    // reapply the resolution to whatever is on the bus now
+    rescan();
+    setResolution(_resolution);
+  }
+  if (_count == 0 || !_one_wire->reset()) {
+    // No presence pulse, look for the sensors again next time
+    _rescan_pending = true;
+    return false;
+  }
+
+  _one_wire->skip();
+  // Parasite powered sensors need the strong pullup during conversion
+  _one_wire->write(CONVERT_T, _parasite ? 1 : 0);
+
+  _conv_start_ms = millis();
+  _read_index = 0;
+  _state = CONVERTING;
+  return true;
+}
+
+bool DS18B20_Bus::poll() {
+  switch (_state) {
+    case CONVERTING:
+      if (conversionDone()) {
+        _one_wire->depower();
+        _state = READING;
+      }
+      return false;
+
+    case READING:
+      readScratchpad(_read_index);
+      _read_index++;
+      if (_read_index < _count) {
+        return false;
+      }
+      _state = IDLE;
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+bool DS18B20_Bus::busy() {
+  return _state != IDLE;
+}
+
+uint8_t DS18B20_Bus::deviceCount() {
+  return _count;
+}
+
+int32_t DS18B20_Bus::temperatureMilli(uint8_t index) {
+  return _temperatures[index];
+}
+
+bool DS18B20_Bus::valid(uint8_t index) {
+  return _valid[index];
+}
+
+const uint8_t *DS18B20_Bus::rom(uint8_t index) {
+  return _roms[index];
+}
+
+uint32_t DS18B20_Bus::scanCount() {
+  return _scan_count;
+}
+
+bool DS18B20_Bus::romValid(const uint8_t *rom) {
+  return rom[0] == _kFamilyCode && OneWire::crc8(rom, _kRomSize - 1) == rom[_kRomSize - 1];
+}
+
+bool DS18B20_Bus::loadRoms() {
+  Preferences prefs;
+  if (!prefs.begin(_nvs_namespace, true)) {
+    return false;
+  }
+  uint8_t count = prefs.getUChar("count", 0);
+  bool loaded = count > 0 && count <= DS18B20_MAX_DEVICES &&
+                prefs.getBytes("roms", _roms, count * _kRomSize) == count * _kRomSize;
+  prefs.end();
+  if (!loaded) {
+    return false;
+  }
+
+  // A corrupted entry means the saved list can't be trusted
+  for (uint8_t i = 0; i < count; i++) {
+    if (!romValid(_roms[i])) {
+      return false;
+    }
+  }
+  _count = count;
+  return true;
+}
+
+void DS18B20_Bus::saveRoms() {
+  Preferences prefs;
+  if (!prefs.begin(_nvs_namespace, false)) {
+    return;
+  }
+  prefs.putUChar("count", _count);
+  prefs.putBytes("roms", _roms, _count * _kRomSize);
+  prefs.end();
+}
+
+void DS18B20_Bus::resetReadings() {
+  for (uint8_t i = 0; i < _count; i++) {
+    _temperatures[i] = 0;
+    _valid[i] = false;
+    _failures[i] = 0;
+  }
+}
+
+bool DS18B20_Bus::conversionDone() {
+  if (millis() - _conv_start_ms >= conversionTimeMs()) {
+    return true;
+  }
+  // Externally powered sensors hold read slots low until they finish,
+  // which usually beats the datasheet worst case
+  return !_parasite && _one_wire->read_bit() == 1;
+}
+
+bool DS18B20_Bus::writeConfig(uint8_t index, uint8_t config) {
+  if (!_one_wire->reset()) {
+    return false;
+  }
+  // TH and TL alarm bytes are unused
+  _one_wire->select(_roms[index]);
+  _one_wire->write(WRITE_SCRATCHPAD);
+  _one_wire->write(0x00);
+  _one_wire->write(0x00);
+  _one_wire->write(config);
+
+  // Keep it in EEPROM too, or a sensor that loses power comes back at
+  // 12 bit and the shorter conversion time no longer holds
+  if (!_one_wire->reset()) {
+    return false;
+  }
+  _one_wire->select(_roms[index]);
+  _one_wire->write(COPY_SCRATCHPAD, _parasite ? 1 : 0);
+  delay(_kCopyTimeMs);
+  _one_wire->depower();
+  return true;
+}
+
+bool DS18B20_Bus::fetchScratchpad(uint8_t index, uint8_t *scratchpad) {
+  if (!_one_wire->reset()) {
+    return false;
+  }
+  _one_wire->select(_roms[index]);
+  _one_wire->write(READ_SCRATCHPAD);
+  for (uint8_t i = 0; i < _kScratchpadSize; i++) {
+    scratchpad[i] = _one_wire->read();
+  }
+
+  // A sensor that is gone leaves the bus high and reads back all 0xFF,
+  // which fails the CRC like any other corrupted read. A bus stuck low
+  // reads all 0x00, which passes it.
+  bool stuck_low = true;
+  for (uint8_t i = 0; i < _kScratchpadSize; i++) {
+    stuck_low &= scratchpad[i] == 0;
+  }
+  return !stuck_low
+         && OneWire::crc8(scratchpad, _kScratchpadSize - 1) == scratchpad[_kScratchpadSize - 1];
+}
+
+void DS18B20_Bus::readScratchpad(uint8_t index) {
+  uint8_t scratchpad[_kScratchpadSize];
+
+  _valid[index] = false;
+  if (!fetchScratchpad(index, scratchpad)) {
+    if (++_failures[index] >= DS18B20_RESCAN_AFTER_FAILURES) {
+      _rescan_pending = true;
+    }
+    return;
+  }
+  _failures[index] = 0;
+
+  // Undefined low bits at reduced resolution read as garbage, mask them
+  int16_t raw = (scratchpad[1] << 8) | scratchpad[0];
+  raw &= ~((1 << (DS18B20_RESOLUTION_12_BIT - _resolution)) - 1);
+
+  // 1/16 C per LSB
+  _temperatures[index] = (int32_t)raw * 1000 / 16;
+  _valid[index] = true;
+}
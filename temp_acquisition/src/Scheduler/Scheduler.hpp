@@ -0,0 +1,109 @@
+/*
+  Cooperative scheduler for loop().
+
+  Tasks are plain functions that do a bounded amount of work and return.
+  Each one runs at its own period instead of the whole sketch sharing one
+  delay(). Call run() from loop(): due tasks move from a hashed timer
+  wheel (1 ms per slot) into a FIFO ready queue, and run() executes one
+  of them per call. Nothing is allocated, every task lives in a fixed
+  table.
+
+  The scheduler measures each task's run time. A run that starts more
+  than deadline_ms after it was due counts as a deadline miss, e.g.
+  because another task hogged the CPU.
+*/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "Arduino.h"
+
+#define SCHEDULER_MAX_TASKS 8
+// Must be a power of two. Tasks further out than this wait extra laps.
+#define SCHEDULER_WHEEL_SLOTS 64
+
+typedef void (*SchedulerTask)(void *context);
+
+struct SchedulerTaskStats {
+  const char *name;
+  uint32_t period_ms;
+  uint32_t runs;
+  uint32_t last_us;
+  uint32_t max_us;
+  uint64_t total_us;
+  uint32_t misses;
+  uint32_t max_late_ms;
+};
+
+class Scheduler {
+public:
+  Scheduler();
+
+  /**
+   * @brief Registers a task.
+   *
+   * @param name A string literal, used in reports.
+   * @param task Function to call, with context as its argument.
+   * @param period_ms Time between runs, 0 for a task that only runs
+   *                  when trigger()ed.
+   * @param deadline_ms Allowed start lateness, 0 to use the period.
+   * @return The task id, or -1 if the table is full.
+   */
+  int8_t add(const char *name,
+             SchedulerTask task,
+             void *context,
+             uint32_t period_ms,
+             uint32_t deadline_ms = 0);
+
+  /**
+   * @brief Makes a task ready to run now, e.g. after an input interrupt
+   *        flag was seen. Not safe to call from an ISR.
+   */
+  void trigger(int8_t id);
+
+  /**
+   * @brief Queues every task that is due and runs at most one.
+   *
+   * @return true if a task ran, false if the scheduler was idle.
+   */
+  bool run();
+
+  uint8_t taskCount();
+  const SchedulerTaskStats &stats(int8_t id);
+  void resetStats();
+
+  /**
+   * @brief Prints one line per task.
+   */
+  void report(Print &out);
+
+private:
+  static const int8_t _kNone = -1;
+
+  struct Task {
+    SchedulerTask function;
+    void *context;
+    uint32_t due_ms;
+    uint32_t deadline_ms;
+    int8_t next;  // Next task in the same wheel slot
+    bool queued;  // In the wheel or the ready queue
+    SchedulerTaskStats stats;
+  };
+
+  Task _tasks[SCHEDULER_MAX_TASKS];
+  uint8_t _task_count;
+
+  int8_t _wheel[SCHEDULER_WHEEL_SLOTS];
+  uint32_t _wheel_ms;
+
+  int8_t _ready[SCHEDULER_MAX_TASKS];
+  uint8_t _ready_head;
+  uint8_t _ready_count;
+
+  void insert(int8_t id);
+  bool unlink(int8_t id);
+  void pushReady(int8_t id);
+  void advance(uint32_t now_ms);
+};
+
+#endif
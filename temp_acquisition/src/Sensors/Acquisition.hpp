@@ -0,0 +1,207 @@
+/*
+  Compile-time sensor framework.
+
+  Every driver follows the same concept and derives from
+  SensorDriver<Driver> (CRTP):
+
+    bool start();      Starts a conversion. false if the sensor is unusable.
+    bool poll();       Never blocks. true once fetch() can be called.
+    bool fetch();      Reads the raw result off the bus.
+    uint8_t count();   Number of readings the driver produces.
+    bool convert(uint8_t reading, int32_t &milli_c);
+                       Converts a fetched reading to milli-degrees C.
+
+  AcquisitionEngine takes the drivers as template parameters and runs
+  them all in one cycle: every sensor is started back to back, then the
+  engine polls whichever are still converting, so conversion times
+  overlap. All calls are resolved at compile time; there are no virtual
+  functions and nothing is allocated.
+*/
+
+#ifndef ACQUISITION_HPP
+#define ACQUISITION_HPP
+
+#include "Arduino.h"
+
+/*
+  Base for sensor drivers. Derived classes implement the *Impl() hooks
+  they need; the defaults describe a single-reading sensor whose result
+  is read during poll().
+*/
+template<typename Driver>
+class SensorDriver {
+public:
+  bool start() {
+    return driver().startImpl();
+  }
+
+  bool poll() {
+    return driver().pollImpl();
+  }
+
+  bool fetch() {
+    return driver().fetchImpl();
+  }
+
+  uint8_t count() {
+    return driver().countImpl();
+  }
+
+  bool convert(uint8_t reading, int32_t &milli_c) {
+    return driver().convertImpl(reading, milli_c);
+  }
+
+protected:
+  bool fetchImpl() {
+    return true;
+  }
+
+  uint8_t countImpl() {
+    return 1;
+  }
+
+private:
+  Driver &driver() {
+    return static_cast<Driver &>(*this);
+  }
+};
+
+// Receives every reading of a cycle, numbered across all drivers
+typedef void (*SampleSink)(uint8_t reading, int32_t milli_c, bool valid);
+
+/*
+  Recursive list of drivers. Each level owns one driver reference and
+  whether it finished this cycle.
+*/
+template<typename... Drivers>
+class SensorGroup;
+
+template<>
+class SensorGroup<> {
+public:
+  void start() {}
+
+  bool step(SampleSink, uint8_t) {
+    return true;
+  }
+
+  uint8_t readings() {
+    return 0;
+  }
+};
+
+template<typename First, typename... Rest>
+class SensorGroup<First, Rest...> {
+public:
+  SensorGroup(First &first, Rest &...rest)
+    : _first(first), _rest(rest...), _done(true) {}
+
+  void start() {
+    // A sensor that fails to start is done for this cycle
+    _done = !_first.start();
+    _rest.start();
+  }
+
+  /**
+   * @brief Polls every sensor still converting and hands finished
+   *        readings to sink.
+   *
+   * @return true once every sensor in the group is done.
+   */
+  bool step(SampleSink sink, uint8_t first_reading) {
+    if (!_done && _first.poll()) {
+      bool fetched = _first.fetch();
+      for (uint8_t i = 0; i < _first.count(); i++) {
+        int32_t milli_c = 0;
+        bool valid = fetched && _first.convert(i, milli_c);
+        sink(first_reading + i, milli_c, valid);
+      }
+      _done = true;
+    }
+    bool rest_done = _rest.step(sink, first_reading + _first.count());
+    return _done && rest_done;
+  }
+
+  uint8_t readings() {
+    return _first.count() + _rest.readings();
+  }
+
+private:
+  First &_first;
+  SensorGroup<Rest...> _rest;
+  bool _done;
+};
+
+template<typename... Drivers>
+class AcquisitionEngine {
+public:
+  AcquisitionEngine(SampleSink sink, Drivers &...drivers)
+    : _group(drivers...), _sink(sink), _running(false),
+      _cycle_start_us(0), _last_cycle_us(0) {}
+
+  /**
+   * @brief Starts a conversion on every sensor.
+   *
+   * @return false if the previous cycle has not finished.
+   */
+  bool startCycle() {
+    if (_running) {
+      return false;
+    }
+    _cycle_start_us = micros();
+    _group.start();
+    _running = true;
+    return true;
+  }
+
+  /**
+   * @brief Advances the running cycle without blocking.
+   *
+   * @return true when the cycle has just completed.
+   */
+  bool step() {
+    if (!_running || !_group.step(_sink, 0)) {
+      return false;
+    }
+    _running = false;
+    _last_cycle_us = micros() - _cycle_start_us;
+    return true;
+  }
+
+  /**
+   * @brief Runs one complete cycle, blocking until every sensor is read.
+   *
+   * @return The cycle time in microseconds.
+   */
+  uint32_t runCycle() {
+    startCycle();
+    while (!step()) {
+      yield();
+    }
+    return _last_cycle_us;
+  }
+
+  bool running() {
+    return _running;
+  }
+
+  /**
+   * @brief Total readings produced per cycle.
+   */
+  uint8_t readings() {
+    return _group.readings();
+  }
+
+  uint32_t lastCycleUs() {
+    return _last_cycle_us;
+  }
+
+private:
+  SensorGroup<Drivers...> _group;
+  SampleSink _sink;
+  bool _running;
+  uint32_t _cycle_start_us;
+  uint32_t _last_cycle_us;
+};
+
+#endif
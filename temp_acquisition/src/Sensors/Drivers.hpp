@@ -0,0 +1,85 @@
+/*
+  Adapters that fit the TSYS01 and DS18B20 drivers to the
+  SensorDriver concept in Acquisition.hpp.
+*/
+
+#ifndef DRIVERS_HPP
+#define DRIVERS_HPP
+
+#include "Acquisition.hpp"
+#include "../TSYS01/tsys01.h"
+#include "../TCA9548A/tca9548a_mux.h"
+#include "../DS18B20/ds18b20_bus.h"
+
+/*
+  One TSYS01, optionally behind a TCA9548A channel.
+*/
+class TSYS01Sensor : public SensorDriver<TSYS01Sensor> {
+public:
+  /**
+   * @param tsys Initialized sensor
+   * @param mux Mux the sensor is behind, or NULL if it is on the bus directly
+   * @param channel Mux channel, unused if mux is NULL
+   */
+  TSYS01Sensor(TSYS01 &tsys, TCA9548A_Mux *mux, uint8_t channel)
+    : _tsys(tsys), _mux(mux), _channel(channel) {}
+
+  bool startImpl() {
+    // An offline sensor fails here and sits the cycle out
+    return select() && _tsys.startConversion();
+  }
+
+  bool pollImpl() {
+    return _tsys.ready();
+  }
+
+  bool fetchImpl() {
+    return select() && _tsys.fetch();
+  }
+
+  bool convertImpl(uint8_t, int32_t &milli_c) {
+    milli_c = (int32_t)(_tsys.temperature() * 1000.0f);
+    return true;
+  }
+
+private:
+  TSYS01 &_tsys;
+  TCA9548A_Mux *_mux;
+  uint8_t _channel;
+
+  bool select() {
+    return _mux == NULL || _mux->selectChannel(_channel);
+  }
+};
+
+/*
+  Every DS18B20 on one OneWire bus. One Skip ROM command starts them
+  all, and poll() reads one scratchpad per call once they finish.
+*/
+class DS18B20BusSensor : public SensorDriver<DS18B20BusSensor> {
+public:
+  DS18B20BusSensor(DS18B20_Bus &bus)
+    : _bus(bus) {}
+
+  bool startImpl() {
+    return _bus.startConversion();
+  }
+
+  bool pollImpl() {
+    return _bus.poll();
+  }
+
+  uint8_t countImpl() {
+    return _bus.deviceCount();
+  }
+
+  bool convertImpl(uint8_t reading, int32_t &milli_c) {
+    milli_c = _bus.temperatureMilli(reading);
+    return _bus.valid(reading);
+  }
+
+private:
+  DS18B20_Bus &_bus;
+};
+
+#endif
@@ -0,0 +1,162 @@
+/*
+  TCA9548A I2C multiplexer with a cached channel mask.
+
+  Every TSYS01 answers on 0x77, so sensors are told apart by the mux
+  channel they sit behind. The control byte is only written when the
+  requested mask differs from the one already on the mux, and
+  MuxSchedule orders sensor accesses so a cycle switches channels as
+  few times as possible.
+*/
+
+#ifndef TCA9548A_MUX_H
+#define TCA9548A_MUX_H
+
+#include "Arduino.h"
+#include <Wire.h>
+#include "../I2CBus/I2CBus.hpp"
+
+#define TCA9548A_CHANNELS 8
+// Largest number of devices a MuxSchedule can order
+#define TCA9548A_MAX_SLOTS 16
+
+class TCA9548A_Mux {
+public:
+  TCA9548A_Mux();
+
+  /**
+   * @brief Sets up the mux and closes all channels.
+   *
+   * @param i2c_interface I2C interface the mux is on
+   * @param i2c_address TCA9548A I2C address
+   */
+  void begin(TwoWire *i2c_interface, uint8_t i2c_address);
+
+  /**
+   * @brief Sets up the mux on a shared bus manager. Every select() and
+   *        every MuxChannelGuard then holds the bus.
+   */
+  void begin(I2CBus *bus, uint8_t i2c_address);
+
+  /**
+   * @brief Enables exactly the channels in mask.
+   *        Skips the bus write if the mux already has this mask.
+   *
+   * @return false if the mux did not acknowledge.
+   */
+  bool select(uint8_t mask);
+
+  /**
+   * @brief Enables one channel and disables all others.
+   */
+  bool selectChannel(uint8_t channel);
+
+  /**
+   * @brief Enables a channel in addition to the ones already open.
+   */
+  bool openChannel(uint8_t channel);
+
+  /**
+   * @brief Disables a channel, leaving the others as they are.
+   */
+  bool closeChannel(uint8_t channel);
+
+  /**
+   * @brief Disables all channels.
+   */
+  bool closeAll();
+
+  /**
+   * @brief Forgets the cached mask so the next select() always writes.
+   *        Use after a bus error or a mux reset.
+   */
+  void invalidate();
+
+  /**
+   * @brief Channel mask currently on the mux.
+   */
+  uint8_t activeMask();
+
+  /**
+   * @brief Number of control byte writes sent and skipped.
+   */
+  uint32_t writes();
+  uint32_t skippedWrites();
+
+  /**
+   * @brief Bus manager the mux is on, NULL when using a bare TwoWire.
+   */
+  I2CBus *bus();
+  uint8_t address();
+
+private:
+  I2CBus *_bus;
+  TwoWire *_i2c_interface;
+  uint8_t _i2c_address;
+
+  uint8_t _active_mask;
+  bool _mask_valid;
+
+  uint32_t _writes;
+  uint32_t _skipped_writes;
+};
+
+/*
+  Selects one mux channel for the lifetime of the guard, so accesses to
+  identically addressed devices in the scope go to the right one.
+  The channel is left selected on exit; the mux cache makes the next
+  guard on the same channel free.
+
+  On a shared bus the guard also holds the bus, so no other task can
+  switch the mux while the guard is alive.
+*/
+class MuxChannelGuard {
+public:
+  MuxChannelGuard(TCA9548A_Mux &mux, uint8_t channel);
+
+  /**
+   * @brief true if the channel was selected.
+   */
+  bool ok();
+
+private:
+  I2CTransaction _transaction;
+  bool _ok;
+
+  // Guards are scoped, never copied
+  MuxChannelGuard(const MuxChannelGuard &);
+  MuxChannelGuard &operator=(const MuxChannelGuard &);
+};
+
+/*
+  Access order for devices behind the mux. Devices are grouped by
+  channel, and the cycle starts on whichever channel is already
+  selected, so a cycle costs at most one switch per channel in use.
+*/
+class MuxSchedule {
+public:
+  MuxSchedule();
+
+  /**
+   * @brief Registers a device behind the mux.
+   *
+   * @return The slot index, or -1 if the schedule is full.
+   */
+  int8_t add(uint8_t channel);
+
+  /**
+   * @brief Computes the access order for the next cycle.
+   *
+   * @param active_mask The mask currently on the mux.
+   * @param order Receives count() slot indices, in access order.
+   */
+  void plan(uint8_t active_mask, uint8_t order[]);
+
+  uint8_t count();
+  uint8_t channel(uint8_t slot);
+
+private:
+  uint8_t _channels[TCA9548A_MAX_SLOTS];
+  uint8_t _count;
+};
+
+#endif
@@ -0,0 +1,174 @@
+/* Blue Robotics Arduino TSYS01 Temperature Sensor Library
+------------------------------------------------------------
+ 
+Title: Blue Robotics Arduino TSYS01 Temperature Sensor Library
+Description: This library provides utilities to communicate with and to
+read data from the Measurement Specialties TSYS01 temperature 
+sensor.
+Authors: Rustom Jehangir, Blue Robotics Inc.
+		 Jonathan Newman, Blue Robotics Inc.
+         Adam Šimko, Blue Robotics Inc.
+-------------------------------
+The MIT License (MIT)
+Copyright (c) 2016 Blue Robotics Inc.
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+-------------------------------*/ 
+
+#ifndef TSYS01_H_BLUEROBOTICS
+#define TSYS01_H_BLUEROBOTICS
+
+#include "Arduino.h"
+#include <Wire.h>
+#include "../I2CBus/I2CBus.hpp"
+
+/** Observed ADC conversion times, in microseconds from the conversion
+ *  command to the first successful ADC read.
+ */
+struct TSYS01_ConversionStats {
+	uint32_t last_us;
+	uint32_t min_us;
+	uint32_t max_us;
+	uint32_t learned_us;
+	uint32_t samples;
+	uint32_t retries;
+};
+
+/** Time the sensor needs after reset() before readCalibration(), per
+ *  datasheet.
+ */
+#define TSYS01_RESET_WAIT_US 10000
+
+class TSYS01 {
+public:
+
+	TSYS01();
+
+	/** reset(), the reset wait, then readCalibration(). Returns false at
+	 *  once if the reset is not acknowledged.
+	 */
+	bool init();
+
+	/** init() in two halves, so the reset wait can be spent on other
+	 *  work. Call readCalibration() no sooner than TSYS01_RESET_WAIT_US
+	 *  after reset().
+	 */
+	bool reset();
+	bool readCalibration();
+
+	/** Routes all bus access through a shared bus manager instead of
+	 *  using Wire directly. Call before init().
+	 */
+	void setBus(I2CBus *bus);
+
+	/** Starts a conversion and fetches the result, blocking for the
+	 *  conversion time: 10 ms, or the learned time in adaptive mode.
+	 *  Returns false if either step failed, leaving temperature() at the
+	 *  last good reading.
+	 */
+	bool read();
+
+	/** Enables adaptive conversion timing. Instead of always waiting the
+	 *  worst-case 10 ms, read() waits the learned conversion time plus a
+	 *  margin and polls again if the ADC is not finished yet.
+	 */
+	void setAdaptive(bool enable);
+
+	/** Starts an ADC conversion. Fetch the result with readAdc() once the
+	 *  conversion time has passed. Returns false if the sensor is offline
+	 *  or did not acknowledge.
+	 */
+	bool startConversion();
+
+	/** Records a conversion started elsewhere, e.g. one command broadcast
+	 *  to several sensors at once, so fetch() knows when it began.
+	 */
+	void conversionStarted(uint32_t start_us);
+
+	/** Returns true once the running conversion should be finished, so
+	 *  fetch() will not have to wait. Never blocks.
+	 */
+	bool ready();
+
+	/** Fetches the result of the running conversion and updates
+	 *  temperature(). Waits until the conversion time has passed, and in
+	 *  adaptive mode polls until the ADC is ready. Returns false at once,
+	 *  without waiting, if the sensor is offline, and leaves temperature()
+	 *  unchanged on any failure.
+	 */
+	bool fetch();
+
+	/** Fetches the result of a conversion known to be finished, e.g. one
+	 *  broadcast to several sensors once another of them has fetched.
+	 *  Neither waits nor learns a conversion time.
+	 */
+	bool fetchResult();
+
+	/** Reads the result of the last conversion. Returns false if the
+	 *  conversion was not finished, in which case the sensor returns 0.
+	 */
+	bool readAdc();
+
+	/** Conversion time statistics gathered in adaptive mode.
+	 */
+	const TSYS01_ConversionStats& conversionStats();
+
+	/** false once the sensor has stopped answering. While offline every
+	 *  call fails at once, apart from a re-probe on a backoff schedule.
+	 */
+	bool online();
+
+	/** Readings dropped because the sensor did not deliver them.
+	 */
+	uint32_t skipped();
+
+	/** This function loads the datasheet test case values to verify that
+	 *  calculations are working correctly. No example checksum is provided
+	 *  so the checksum test may fail.
+	 */
+	void readTestCase();
+
+	/** Temperature returned in deg C.
+	 */
+	float temperature();
+
+private:
+	uint16_t C[8];
+	uint32_t D1;
+	float TEMP;
+	uint32_t adc;
+
+	TwoWire *_wire;
+	I2CBus *_bus;
+	I2CDeviceHealth _health;
+
+	bool _adaptive;
+	uint32_t _conv_start_us;
+	TSYS01_ConversionStats _stats;
+
+	/** Waits for the conversion started by startConversion() using the
+	 *  learned conversion time, then updates the statistics.
+	 */
+	bool waitForConversion();
+
+	/** Performs calculations per the sensor data sheet for conversion and
+	 *  second order compensation.
+	 */
+	void calculate();
+
+};
+
+#endif
@@ -0,0 +1,104 @@
+/*
+  Compact binary telemetry over a serial link.
+
+  Each record is packed little endian, followed by a CRC-16/MODBUS of the
+  record, then COBS encoded and terminated with a 0x00 byte. A decoder
+  can resynchronize at any 0x00 and drop frames that fail the CRC.
+  tools/telemetry_decode.py decodes the stream on the host.
+
+  Record layout:
+    type (1) | sequence (1) | timestamp_ms (4) | body
+
+  Bodies:
+    SAMPLE         sensor (1) | milli_c (int32)
+    MODBUS_RESULT  server_id (1) | function_code (1) | result (1) |
+                   count (1) | registers (uint16 x count)
+    GPIO_EVENT     device (1) | pins (uint16) | changed (uint16)
+    TASK_STATS     task (1) | runs (uint32) | mean_us (uint32) |
+                   max_us (uint32) | misses (uint32)
+*/
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include "Arduino.h"
+
+enum TelemetryRecordType {
+  TELEMETRY_SAMPLE = 0x01,
+  TELEMETRY_MODBUS_RESULT = 0x02,
+  TELEMETRY_GPIO_EVENT = 0x03,
+  TELEMETRY_TASK_STATS = 0x04,
+};
+
+// Registers carried by one MODBUS_RESULT record
+#define TELEMETRY_MAX_REGISTERS 16
+
+class Telemetry {
+public:
+  Telemetry();
+
+  /**
+   * @brief Sets the stream frames are written to and sends a delimiter
+   *        so the first frame decodes cleanly.
+   */
+  void begin(Print *out);
+
+  /**
+   * @brief Sends one timestamped sensor reading.
+   */
+  bool sample(uint8_t sensor, int32_t milli_c);
+
+  /**
+   * @brief Sends the outcome of a Modbus transaction.
+   *
+   * @param registers Register values, may be NULL if count is 0.
+   * @param count Number of registers, clamped to TELEMETRY_MAX_REGISTERS.
+   */
+  bool modbusResult(uint8_t server_id,
+                    uint8_t function_code,
+                    uint8_t result,
+                    const uint16_t *registers,
+                    uint8_t count);
+
+  /**
+   * @brief Sends a change of GPIO expander inputs.
+   */
+  bool gpioEvent(uint8_t device, uint16_t pins, uint16_t changed);
+
+  /**
+   * @brief Sends the run time and deadline misses of a scheduler task.
+   */
+  bool taskStats(uint8_t task,
+                 uint32_t runs,
+                 uint32_t mean_us,
+                 uint32_t max_us,
+                 uint32_t misses);
+
+  uint32_t framesSent();
+  uint32_t bytesSent();
+
+private:
+  static const uint8_t _kHeaderSize = 6;
+  static const uint8_t _kCrcSize = 2;
+  static const uint8_t _kMaxRecordSize = _kHeaderSize + 4 + 2 * TELEMETRY_MAX_REGISTERS + _kCrcSize;
+  // COBS adds one byte per 254, plus the delimiter
+  static const uint8_t _kMaxFrameSize = _kMaxRecordSize + _kMaxRecordSize / 254 + 2;
+
+  Print *_out;
+  uint8_t _sequence;
+  uint32_t _frames_sent;
+  uint32_t _bytes_sent;
+
+  uint8_t _record[_kMaxRecordSize];
+  uint8_t _frame[_kMaxFrameSize];
+
+  uint8_t beginRecord(TelemetryRecordType type);
+  bool send(uint8_t length);
+
+  static uint8_t put16(uint8_t *buffer, uint8_t index, uint16_t value);
+  static uint8_t put32(uint8_t *buffer, uint8_t index, uint32_t value);
+  static uint16_t crc16(const uint8_t *buffer, uint8_t length);
+  static uint8_t cobsEncode(const uint8_t *in, uint8_t length, uint8_t *out);
+};
+
+#endif
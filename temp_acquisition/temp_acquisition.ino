@@ -0,0 +1,249 @@
+#include <Wire.h>
+#include <OneWire.h>
+#include "src/Sensors/Drivers.hpp"
+#include "src/Telemetry/Telemetry.hpp"
+#include "src/Scheduler/Scheduler.hpp"
+#include "src/Board/Board.hpp"
+#include "src/MAX7314/MAX7314.hpp"
+#include "src/Boot/BootSequencer.hpp"
+
+enum PinNumbers {
+  ONE_WIRE = 15,
+};
+
+// Expanders and sensors each have their own I2C controller
+Board board;
+
+// Inputs on 8 - 15, read alongside the sensors. Pin roles are in
+// src/Board/BoardDescription.hpp
+MAX7314 expanderOne;
+uint16_t last_inputs = 0;
+
+// TSYS01s behind the mux, all on 0x77
+TCA9548A_Mux i2c_mux;
+TSYS01 tsys_1;
+TSYS01 tsys_2;
+TSYS01Sensor sensor_1(tsys_1, &i2c_mux, 0);
+TSYS01Sensor sensor_2(tsys_2, &i2c_mux, 1);
+
+// DS18B20 liquid temperature string
+OneWire one_wire(ONE_WIRE);
+DS18B20_Bus ds;
+DS18B20BusSensor liquid(ds);
+
+void store_reading(uint8_t reading, int32_t milli_c, bool valid);
+
+AcquisitionEngine<TSYS01Sensor, TSYS01Sensor, DS18B20BusSensor>
+  engine(store_reading, sensor_1, sensor_2, liquid);
+
+// Every reading goes out as a binary frame, see tools/telemetry_decode.py
+Telemetry telemetry;
+
+// Acquisition steps every millisecond, task stats go out every 10 s
+Scheduler scheduler;
+const uint32_t acquire_period_ms = 1;
+const uint32_t inputs_period_ms = 50;
+const uint32_t report_period_ms = 10000;
+
+// Compare against the old per-sketch loops at startup
+const bool run_benchmark = true;
+const uint8_t benchmark_cycles = 10;
+
+// Subsystems come up side by side, each waiting only on itself
+BootSequencer boot;
+// micros() since power-up of the first valid reading
+uint32_t first_sample_us = 0;
+
+struct TsysSlot {
+  TSYS01 *tsys;
+  uint8_t channel;
+};
+TsysSlot tsys_slots[] = { { &tsys_1, 0 }, { &tsys_2, 1 } };
+
+void store_reading(uint8_t reading, int32_t milli_c, bool valid) {
+  if (valid) {
+    if (first_sample_us == 0) {
+      first_sample_us = micros();
+    }
+    telemetry.sample(reading, milli_c);
+  }
+}
+
+bool boot_expander_init(void *context) {
+  return expanderOne.init(board.busFor(BOARD_EXPANDER_1), board.address(BOARD_EXPANDER_1), kExpander1Image);
+}
+
+bool boot_expander_read(void *context) {
+  return expanderOne.readPins(&last_inputs) == I2C_OK;
+}
+
+bool boot_tsys_reset(void *context) {
+  TsysSlot *slot = (TsysSlot *)context;
+  return i2c_mux.selectChannel(slot->channel) && slot->tsys->reset();
+}
+
+bool boot_tsys_calibrate(void *context) {
+  TsysSlot *slot = (TsysSlot *)context;
+  return i2c_mux.selectChannel(slot->channel) && slot->tsys->readCalibration();
+}
+
+bool boot_ds18b20(void *context) {
+  return ds.begin(&one_wire, DS18B20_RESOLUTION_10_BIT) > 0;
+}
+
+const BootStep expander_boot[] = {
+  { "init", boot_expander_init, 0 },
+  { "read", boot_expander_read, 0 },
+};
+
+const BootStep tsys_boot[] = {
+  { "reset", boot_tsys_reset, TSYS01_RESET_WAIT_US },
+  { "calibrate", boot_tsys_calibrate, 0 },
+};
+
+const BootStep ds18b20_boot[] = {
+  { "search", boot_ds18b20, 0 },
+};
+
+/*
+  One cycle the way tsys01.ino, i2c_multi_test.ino and
+  liquid_temp_test.ino did it: each TSYS01 read blocks for its full
+  conversion, then one conversion of every DS18B20 is waited out before
+  their scratchpads are read.
+*/
+uint32_t sequential_cycle() {
+  uint32_t start = micros();
+
+  i2c_mux.selectChannel(0);
+  tsys_1.read();
+  i2c_mux.selectChannel(1);
+  tsys_2.read();
+
+  // poll() reads every scratchpad once the conversion is done
+  if (ds.startConversion()) {
+    while (!ds.poll()) {
+      yield();
+    }
+  }
+
+  return micros() - start;
+}
+
+void benchmark() {
+  uint32_t sequential_total = 0;
+  uint32_t engine_total = 0;
+
+  for (uint8_t i = 0; i < benchmark_cycles; i++) {
+    sequential_total += sequential_cycle();
+  }
+  for (uint8_t i = 0; i < benchmark_cycles; i++) {
+    engine_total += engine.runCycle();
+  }
+
+  Serial.printf("BENCH sequential: %u us/cycle\n", sequential_total / benchmark_cycles);
+  Serial.printf("BENCH engine:     %u us/cycle\n", engine_total / benchmark_cycles);
+
+  // An expander read plus a sensor cycle, one after the other and then
+  // with the read running on the expander bus worker meanwhile
+  uint32_t serial_total = 0;
+  uint32_t parallel_total = 0;
+  for (uint8_t i = 0; i < benchmark_cycles; i++) {
+    uint32_t start = micros();
+    expanderOne.readPins();
+    engine.runCycle();
+    serial_total += micros() - start;
+  }
+  for (uint8_t i = 0; i < benchmark_cycles; i++) {
+    uint32_t start = micros();
+    expanderOne.readPinsAsync();
+    engine.runCycle();
+    while (expanderOne.asyncBusy()) {
+      yield();
+    }
+    parallel_total += micros() - start;
+  }
+
+  Serial.printf("BENCH inputs + cycle, one bus at a time: %u us\n", serial_total / benchmark_cycles);
+  Serial.printf("BENCH inputs + cycle, both buses:        %u us\n", parallel_total / benchmark_cycles);
+}
+
+void setup() {
+  Serial.begin(115200);
+  if (!board.begin()) {
+    Serial.println("I2C bus start failed!");
+  }
+
+  i2c_mux.begin(board.busFor(BOARD_MUX), board.address(BOARD_MUX));
+  tsys_1.setBus(board.busFor(BOARD_TSYS01));
+  tsys_2.setBus(board.busFor(BOARD_TSYS01));
+
+  // Both TSYS01 reset waits, the expander setup and the DS18B20 search
+  // all overlap
+  boot.add("expander", expander_boot, sizeof(expander_boot) / sizeof(BootStep), NULL);
+  boot.add("tsys_1", tsys_boot, sizeof(tsys_boot) / sizeof(BootStep), &tsys_slots[0]);
+  boot.add("tsys_2", tsys_boot, sizeof(tsys_boot) / sizeof(BootStep), &tsys_slots[1]);
+  boot.add("ds18b20", ds18b20_boot, sizeof(ds18b20_boot) / sizeof(BootStep), NULL);
+  boot.run();
+
+  // Time one cycle to the first reading. Telemetry is not started yet,
+  // so these readings are not sent.
+  engine.runCycle();
+  boot.report(Serial);
+  Serial.printf("BOOT first sample %u us after power-up\n", first_sample_us);
+  Serial.printf("DS18B20 found: %d\n", ds.deviceCount());
+
+  if (run_benchmark) {
+    benchmark();
+  }
+
+  tsys_1.setAdaptive(true);
+  tsys_2.setAdaptive(true);
+
+  // No more text from here on, the link carries telemetry frames only
+  telemetry.begin(&Serial);
+
+  scheduler.add("acquire", step_acquisition, NULL, acquire_period_ms);
+  scheduler.add("inputs", poll_inputs, NULL, inputs_period_ms);
+  scheduler.add("report", report_tasks, NULL, report_period_ms);
+}
+
+void step_acquisition(void *context) {
+  if (!engine.running()) {
+    engine.startCycle();
+  }
+  engine.step();
+}
+
+/*
+  Picks up the read started on the previous run and starts the next one.
+  The read runs on the expander bus worker while the sensors keep the
+  other bus busy.
+*/
+void poll_inputs(void *context) {
+  static bool read_started = false;
+  if (expanderOne.asyncBusy()) {
+    return;
+  }
+
+  uint16_t inputs;
+  if (read_started && expanderOne.asyncPins(&inputs) == I2C_OK && inputs != last_inputs) {
+    telemetry.gpioEvent(board.address(BOARD_EXPANDER_1), inputs, inputs ^ last_inputs);
+    last_inputs = inputs;
+  }
+  read_started = expanderOne.readPinsAsync();
+}
+
+void report_tasks(void *context) {
+  for (uint8_t i = 0; i < scheduler.taskCount(); i++) {
+    const SchedulerTaskStats &stats = scheduler.stats(i);
+    telemetry.taskStats(i, stats.runs,
+                        stats.runs > 0 ? (uint32_t)(stats.total_us / stats.runs) : 0,
+                        stats.max_us, stats.misses);
+  }
+}
+
+void loop() {
+  if (!scheduler.run()) {
+    yield();
+  }
+}
@@ -0,0 +1,147 @@
+/*
+  Just enough of Arduino.h to build the sketches' drivers on the host.
+
+  Time only moves when a check calls simAdvanceUs() / simAdvanceMs(), or
+  when a driver waits with delay() or delayMicroseconds(), so every
+  check runs the same way each time. GPIOs remember when they last
+  changed, in that same time. FreeRTOS tasks and ticks run on
+  real threads and real time, see FreeRTOS.h.
+*/
+
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+#include <stdint.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <atomic>
+#include "FreeRTOS.h"
+
+extern std::atomic<uint64_t> sim_now_us;
+
+inline void simAdvanceUs(uint32_t us) {
+  sim_now_us += us;
+}
+
+inline void simAdvanceMs(uint32_t ms) {
+  sim_now_us += (uint64_t)ms * 1000;
+}
+
+inline uint32_t micros() {
+  return (uint32_t)sim_now_us;
+}
+
+inline uint32_t millis() {
+  return (uint32_t)(sim_now_us / 1000);
+}
+
+inline void delayMicroseconds(uint32_t us) {
+  simAdvanceUs(us);
+}
+
+inline void delay(uint32_t ms) {
+  simAdvanceMs(ms);
+}
+
+inline void yield() {
+}
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define SIM_PIN_COUNT 40
+
+// Level of each GPIO and the sim time it last changed
+struct SimPin {
+  uint8_t level;
+  uint32_t changed_us;
+};
+
+inline SimPin *simPins() {
+  static SimPin pins[SIM_PIN_COUNT];
+  return pins;
+}
+
+inline void pinMode(uint8_t pin, uint8_t mode) {
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t level) {
+  SimPin &state = simPins()[pin];
+  if (state.level != level) {
+    state.level = level;
+    state.changed_us = micros();
+  }
+}
+
+inline int digitalRead(uint8_t pin) {
+  return simPins()[pin].level;
+}
+
+#define FALLING 2
+#define digitalPinToInterrupt(pin) (pin)
+
+// Interrupts never fire on the host
+inline void attachInterrupt(uint8_t interrupt, void (*callback)(void), int mode) {
+}
+
+// Only what the drivers print with
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t value) = 0;
+
+  virtual size_t write(const uint8_t *buffer, size_t size) {
+    size_t written = 0;
+    while (written < size && write(buffer[written])) {
+      written++;
+    }
+    return written;
+  }
+
+  virtual void flush() {}
+
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    for (int i = 0; i < length && i < (int)sizeof(text) - 1; i++) {
+      write(text[i]);
+    }
+    return length;
+  }
+};
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
+
+class SimSerial : public Print {
+public:
+  size_t write(uint8_t value) {
+    return fputc(value, stdout) == EOF ? 0 : 1;
+  }
+};
+
+static SimSerial Serial;
+
+// Checks print every failure and count them, main() returns the count
+extern int sim_failures;
+
+#define SIM_CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #condition); \
+      sim_failures++; \
+    } \
+  } while (0)
+
+#endif
@@ -0,0 +1,163 @@
+/*
+  The FreeRTOS calls the sketches' drivers use, on std::thread.
+
+  Every task is a thread with its own notification count. Critical
+  sections share one mutex, which is as strong as the ESP32's spinlock
+  for code that only has to be correct, not fast. Queues copy items in
+  and out like FreeRTOS queues. Ticks are milliseconds of real time.
+*/
+
+#ifndef SIM_FREERTOS_H
+#define SIM_FREERTOS_H
+
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define portMAX_DELAY 0xFFFFFFFFUL
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+struct SimTask {
+  std::mutex mutex;
+  std::condition_variable wake;
+  uint32_t notifications;
+
+  SimTask()
+    : notifications(0) {}
+};
+
+typedef SimTask *TaskHandle_t;
+
+inline TaskHandle_t &simCurrentTask() {
+  static thread_local TaskHandle_t task = NULL;
+  return task;
+}
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+  TaskHandle_t &task = simCurrentTask();
+  if (task == NULL) {
+    // A thread the simulation did not start, e.g. main()
+    task = new SimTask();
+  }
+  return task;
+}
+
+inline BaseType_t xTaskCreatePinnedToCore(void (*function)(void *), const char *name,
+                                          uint32_t stack_size, void *parameters,
+                                          UBaseType_t priority, TaskHandle_t *created,
+                                          int core) {
+  TaskHandle_t task = new SimTask();
+  if (created != NULL) {
+    *created = task;
+  }
+  std::thread([function, parameters, task]() {
+    simCurrentTask() = task;
+    function(parameters);
+  }).detach();
+  return pdPASS;
+}
+
+inline void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  std::lock_guard<std::mutex> lock(task->mutex);
+  task->notifications++;
+  task->wake.notify_one();
+  return pdPASS;
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks) {
+  TaskHandle_t task = xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> lock(task->mutex);
+  if (ticks == portMAX_DELAY) {
+    task->wake.wait(lock, [task]() { return task->notifications > 0; });
+  } else {
+    task->wake.wait_for(lock, std::chrono::milliseconds(ticks),
+                        [task]() { return task->notifications > 0; });
+  }
+  uint32_t value = task->notifications;
+  if (value > 0) {
+    task->notifications = clear_on_exit ? 0 : value - 1;
+  }
+  return value;
+}
+
+struct portMUX_TYPE {
+  uint32_t unused;
+};
+
+#define portMUX_INITIALIZER_UNLOCKED portMUX_TYPE()
+
+inline std::mutex &simCriticalMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+inline void portENTER_CRITICAL(portMUX_TYPE *mux) {
+  simCriticalMutex().lock();
+}
+
+inline void portEXIT_CRITICAL(portMUX_TYPE *mux) {
+  simCriticalMutex().unlock();
+}
+
+struct SimQueue {
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<std::vector<uint8_t>> items;
+  UBaseType_t length;
+  UBaseType_t item_size;
+};
+
+typedef SimQueue *QueueHandle_t;
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size) {
+  QueueHandle_t queue = new SimQueue();
+  queue->length = length;
+  queue->item_size = item_size;
+  return queue;
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  auto has_room = [queue]() { return queue->items.size() < queue->length; };
+  if (ticks == portMAX_DELAY) {
+    queue->changed.wait(lock, has_room);
+  } else if (!queue->changed.wait_for(lock, std::chrono::milliseconds(ticks), has_room)) {
+    return pdFALSE;
+  }
+  const uint8_t *bytes = (const uint8_t *)item;
+  queue->items.push_back(std::vector<uint8_t>(bytes, bytes + queue->item_size));
+  queue->changed.notify_all();
+  return pdTRUE;
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) {
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  auto has_item = [queue]() { return !queue->items.empty(); };
+  if (ticks == portMAX_DELAY) {
+    queue->changed.wait(lock, has_item);
+  } else if (!queue->changed.wait_for(lock, std::chrono::milliseconds(ticks), has_item)) {
+    return pdFALSE;
+  }
+  memcpy(item, queue->items.front().data(), queue->item_size);
+  queue->items.pop_front();
+  queue->changed.notify_all();
+  return pdTRUE;
+}
+
+#endif
@@ -0,0 +1,152 @@
+/*
+  Simulated ESP32 HardwareSerial, transmit side.
+
+  Bytes written go into a 128 byte TX FIFO and leave it at the line rate
+  the baud rate and frame format give, in the virtual time of
+  Arduino.h. flush() waits, i.e. advances time, until the last stop bit
+  is out. availableForWrite() is the free FIFO space, and each call to
+  it costs a microsecond, so a driver polling it sees the FIFO drain.
+
+  Set sim_rs485 to let setMode(UART_MODE_RS485_HALF_DUPLEX) succeed. The
+  UART then drives DE itself, high from the first start bit to the last
+  stop bit, and logs it in sim_de_rise_us / sim_de_fall_us.
+*/
+
+#ifndef SIM_HARDWARE_SERIAL_H
+#define SIM_HARDWARE_SERIAL_H
+
+#include "Arduino.h"
+#include <deque>
+
+#define SERIAL_8N1 0x800001c
+#define SERIAL_8E1 0x800001e
+#define SERIAL_8N2 0x800003c
+
+#define UART_HW_FLOWCTRL_DISABLE 0
+#define UART_MODE_UART 0
+#define UART_MODE_RS485_HALF_DUPLEX 1
+
+#define SIM_UART_FIFO_LENGTH 128
+
+class HardwareSerial : public Stream {
+public:
+  HardwareSerial(int uart_number)
+    : sim_rs485(false), sim_de_rise_us(0), sim_de_fall_us(0), sim_bytes(0),
+      _byte_ns(0), _tx_end_ns(0), _rs485(false) {}
+
+  bool sim_rs485;
+  uint32_t sim_de_rise_us;
+  uint32_t sim_de_fall_us;
+  // Bytes that went out on the wire
+  uint32_t sim_bytes;
+  // Bytes for read() to return, as if received
+  std::deque<uint8_t> sim_rx;
+
+  void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rx_pin = -1,
+             int8_t tx_pin = -1) {
+    uint8_t data_bits = ((config >> 2) & 0x03) + 5;
+    uint8_t parity_bits = (config & 0x02) ? 1 : 0;
+    uint8_t stop_bits = ((config >> 4) & 0x03) == 3 ? 2 : 1;
+    _byte_ns = (uint64_t)(1 + data_bits + parity_bits + stop_bits) * 1000000000ULL / baud;
+    _tx_end_ns = nowNs();
+    _rs485 = false;
+  }
+
+  bool setPins(int8_t rx_pin, int8_t tx_pin, int8_t cts_pin, int8_t rts_pin) {
+    return true;
+  }
+
+  bool setHwFlowCtrlMode(uint8_t mode) {
+    return true;
+  }
+
+  bool setMode(uint8_t mode) {
+    if (mode == UART_MODE_RS485_HALF_DUPLEX && !sim_rs485) {
+      return false;
+    }
+    _rs485 = mode == UART_MODE_RS485_HALF_DUPLEX;
+    return true;
+  }
+
+  size_t write(uint8_t value) override {
+    return write(&value, 1);
+  }
+
+  size_t write(const uint8_t *buffer, size_t size) override {
+    uint64_t now_ns = nowNs();
+    if (_tx_end_ns <= now_ns) {
+      // Idle line, the first start bit goes out now
+      _tx_end_ns = now_ns;
+      if (_rs485) {
+        sim_de_rise_us = (uint32_t)(now_ns / 1000);
+      }
+    }
+    _tx_end_ns += size * _byte_ns;
+    sim_bytes += size;
+    if (_rs485) {
+      sim_de_fall_us = (uint32_t)((_tx_end_ns + 999) / 1000);
+    }
+    return size;
+  }
+
+  int availableForWrite() {
+    simAdvanceUs(1);
+    return SIM_UART_FIFO_LENGTH - fifoBytes();
+  }
+
+  void flush() override {
+    uint64_t now_ns = nowNs();
+    if (_tx_end_ns > now_ns) {
+      simAdvanceUs((uint32_t)((_tx_end_ns - now_ns + 999) / 1000));
+    }
+  }
+
+  int available() override {
+    return sim_rx.size();
+  }
+
+  int read() override {
+    if (sim_rx.empty()) {
+      return -1;
+    }
+    int value = sim_rx.front();
+    sim_rx.pop_front();
+    return value;
+  }
+
+  int peek() override {
+    return sim_rx.empty() ? -1 : sim_rx.front();
+  }
+
+  /**
+   * @brief Sim time the last stop bit queued so far goes out.
+   */
+  uint64_t simTxEndNs() {
+    return _tx_end_ns;
+  }
+
+  uint64_t simByteNs() {
+    return _byte_ns;
+  }
+
+private:
+  uint64_t _byte_ns;
+  uint64_t _tx_end_ns;
+  bool _rs485;
+
+  static uint64_t nowNs() {
+    return sim_now_us * 1000;
+  }
+
+  // Bytes waiting in the FIFO, not counting the one being shifted out
+  uint32_t fifoBytes() {
+    uint64_t now_ns = nowNs();
+    if (_tx_end_ns <= now_ns) {
+      return 0;
+    }
+    uint32_t on_wire = (uint32_t)((_tx_end_ns - now_ns + _byte_ns - 1) / _byte_ns);
+    return on_wire - 1;
+  }
+};
+
+#endif
@@ -0,0 +1,291 @@
+/*
+  Simulated OneWire bus with DS18B20s on it, standing in for the OneWire
+  library on the host.
+
+  Each SimDS18B20 answers ROM and function commands the way the
+  datasheet describes: Convert T takes conversion_us and reads 0 on the
+  bus until it is done, the scratchpad carries its CRC, and Copy
+  Scratchpad saves TH, TL and the config byte to EEPROM, which is all a
+  power cycle keeps. Faults are switched on per device (absent,
+  corrupted reads) or for the whole bus (reads stuck at 0).
+*/
+
+#ifndef SIM_ONE_WIRE_H
+#define SIM_ONE_WIRE_H
+
+#include "Arduino.h"
+#include <vector>
+
+struct SimDS18B20 {
+  uint8_t rom[8];
+  // What the next conversion will measure
+  int32_t milli_c;
+  bool present;
+  bool parasite;
+  uint32_t conversion_us;
+  // The next reads of the scratchpad have one bit flipped
+  uint8_t corrupt_reads;
+
+  int16_t raw;
+  uint8_t th;
+  uint8_t tl;
+  uint8_t config;
+  uint8_t eeprom[3];
+  bool converting;
+  uint64_t done_at_us;
+
+  uint32_t conversions;
+  uint32_t copies;
+
+  void powerCycle() {
+    // 85 C until the first conversion, settings from EEPROM
+    raw = 85 * 16;
+    th = eeprom[0];
+    tl = eeprom[1];
+    config = eeprom[2];
+    converting = false;
+  }
+
+  uint8_t resolution() {
+    return 9 + ((config >> 5) & 0x03);
+  }
+
+  void scratchpad(uint8_t *out);
+};
+
+class OneWire {
+public:
+  explicit OneWire(uint8_t pin) {
+    _phase = IDLE;
+    _search_index = 0;
+    sim_reads_stuck_low = false;
+  }
+
+  /**
+   * @brief Adds a sensor with the given serial number, at power-up
+   *        defaults: 12 bit, 85 C in the scratchpad.
+   */
+  SimDS18B20 &simAdd(uint8_t serial, int32_t milli_c) {
+    SimDS18B20 device;
+    memset(&device, 0, sizeof(device));
+    device.rom[0] = 0x28;
+    device.rom[1] = serial;
+    device.rom[7] = crc8(device.rom, 7);
+    device.milli_c = milli_c;
+    device.present = true;
+    device.conversion_us = 600000;
+    device.eeprom[0] = 0x4B;
+    device.eeprom[1] = 0x46;
+    device.eeprom[2] = 0x7F;
+    device.powerCycle();
+    sim_devices.push_back(device);
+    return sim_devices.back();
+  }
+
+  std::vector<SimDS18B20> sim_devices;
+  // Every read slot reads 0, as with a shorted data line
+  bool sim_reads_stuck_low;
+
+  uint8_t reset() {
+    update();
+    _phase = ROM_COMMAND;
+    _selected.clear();
+    for (size_t i = 0; i < sim_devices.size(); i++) {
+      if (sim_devices[i].present) {
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  void skip() {
+    _selected.clear();
+    for (size_t i = 0; i < sim_devices.size(); i++) {
+      if (sim_devices[i].present) {
+        _selected.push_back(i);
+      }
+    }
+    _phase = FUNCTION;
+  }
+
+  void select(const uint8_t rom[8]) {
+    _selected.clear();
+    for (size_t i = 0; i < sim_devices.size(); i++) {
+      if (sim_devices[i].present && memcmp(sim_devices[i].rom, rom, 8) == 0) {
+        _selected.push_back(i);
+      }
+    }
+    _phase = FUNCTION;
+  }
+
+  void write(uint8_t value, uint8_t power = 0) {
+    update();
+    if (_phase == WRITE_DATA) {
+      for (size_t i = 0; i < _selected.size(); i++) {
+        SimDS18B20 &device = sim_devices[_selected[i]];
+        uint8_t *fields[] = { &device.th, &device.tl, &device.config };
+        if (_position < 3) {
+          // The unused config bits always read 1
+          *fields[_position] = _position == 2 ? (value & 0x60) | 0x1F : value;
+        }
+      }
+      _position++;
+      return;
+    }
+    if (_phase != FUNCTION) {
+      return;
+    }
+
+    _position = 0;
+    _phase = IDLE;
+    for (size_t i = 0; i < _selected.size(); i++) {
+      SimDS18B20 &device = sim_devices[_selected[i]];
+      switch (value) {
+        case 0x44:  // Convert T
+          device.converting = true;
+          device.done_at_us = sim_now_us + device.conversion_us;
+          device.conversions++;
+          break;
+        case 0x48:  // Copy Scratchpad
+          device.eeprom[0] = device.th;
+          device.eeprom[1] = device.tl;
+          device.eeprom[2] = device.config;
+          device.copies++;
+          break;
+        case 0xB8:  // Recall EEPROM
+          device.powerCycle();
+          break;
+      }
+    }
+    switch (value) {
+      case 0x44:
+        _phase = CONVERTING;
+        break;
+      case 0x4E:
+        _phase = WRITE_DATA;
+        break;
+      case 0xBE:
+        _phase = READ_DATA;
+        break;
+      case 0xB4:
+        _phase = POWER_SUPPLY;
+        break;
+    }
+  }
+
+  uint8_t read() {
+    update();
+    uint8_t value = 0xFF;
+    if (_phase == READ_DATA && _position < 9) {
+      // Open drain: every selected device pulls its 0 bits low
+      for (size_t i = 0; i < _selected.size(); i++) {
+        SimDS18B20 &device = sim_devices[_selected[i]];
+        uint8_t bytes[9];
+        device.scratchpad(bytes);
+        uint8_t byte = bytes[_position];
+        if (device.corrupt_reads > 0 && _position == 0) {
+          byte ^= 0x04;
+          device.corrupt_reads--;
+        }
+        value &= byte;
+      }
+      _position++;
+    }
+    return sim_reads_stuck_low ? 0 : value;
+  }
+
+  uint8_t read_bit() {
+    update();
+    if (sim_reads_stuck_low) {
+      return 0;
+    }
+    for (size_t i = 0; i < _selected.size(); i++) {
+      SimDS18B20 &device = sim_devices[_selected[i]];
+      if (_phase == POWER_SUPPLY && device.parasite) {
+        return 0;
+      }
+      if (_phase == CONVERTING && device.converting) {
+        return 0;
+      }
+    }
+    return 1;
+  }
+
+  void depower() {
+  }
+
+  void reset_search() {
+    _search_index = 0;
+  }
+
+  uint8_t search(uint8_t *rom) {
+    while (_search_index < sim_devices.size()) {
+      SimDS18B20 &device = sim_devices[_search_index++];
+      if (device.present) {
+        memcpy(rom, device.rom, 8);
+        return 1;
+      }
+    }
+    return 0;
+  }
+
+  static uint8_t crc8(const uint8_t *data, uint8_t length) {
+    uint8_t crc = 0;
+    while (length--) {
+      uint8_t byte = *data++;
+      for (uint8_t i = 0; i < 8; i++) {
+        uint8_t mix = (crc ^ byte) & 0x01;
+        crc >>= 1;
+        if (mix) {
+          crc ^= 0x8C;
+        }
+        byte >>= 1;
+      }
+    }
+    return crc;
+  }
+
+private:
+  enum Phase {
+    IDLE,
+    ROM_COMMAND,
+    FUNCTION,
+    CONVERTING,
+    WRITE_DATA,
+    READ_DATA,
+    POWER_SUPPLY,
+  };
+
+  Phase _phase;
+  std::vector<size_t> _selected;
+  uint8_t _position;
+  size_t _search_index;
+
+  // Latches the result of every conversion that has finished by now
+  void update() {
+    for (size_t i = 0; i < sim_devices.size(); i++) {
+      SimDS18B20 &device = sim_devices[i];
+      if (device.converting && sim_now_us >= device.done_at_us) {
+        device.converting = false;
+        int16_t raw = (int16_t)(device.milli_c * 16 / 1000);
+        // Bits below the resolution are undefined, make them visible
+        uint8_t unused = 12 - device.resolution();
+        device.raw = (raw & ~((1 << unused) - 1)) | ((1 << unused) - 1);
+      }
+    }
+  }
+};
+
+inline void SimDS18B20::scratchpad(uint8_t *out) {
+  out[0] = raw & 0xFF;
+  out[1] = (raw >> 8) & 0xFF;
+  out[2] = th;
+  out[3] = tl;
+  out[4] = config;
+  out[5] = 0xFF;
+  out[6] = 0x0C;
+  out[7] = 0x10;
+  out[8] = OneWire::crc8(out, 8);
+}
+
+#endif
@@ -0,0 +1,67 @@
+/*
+  In-memory stand-in for the ESP32 Preferences (NVS) library. Every
+  namespace lives until simClear() and survives across Preferences
+  objects, like NVS across reboots.
+*/
+
+#ifndef SIM_PREFERENCES_H
+#define SIM_PREFERENCES_H
+
+#include "Arduino.h"
+#include <map>
+#include <string>
+#include <vector>
+
+class Preferences {
+public:
+  bool begin(const char *name, bool read_only = false) {
+    _name = name;
+    _read_only = read_only;
+    return true;
+  }
+
+  void end() {
+  }
+
+  uint8_t getUChar(const char *key, uint8_t default_value = 0) {
+    std::vector<uint8_t> &value = store()[_name + "/" + key];
+    return value.size() == 1 ? value[0] : default_value;
+  }
+
+  size_t putUChar(const char *key, uint8_t value) {
+    return putBytes(key, &value, 1);
+  }
+
+  size_t getBytes(const char *key, void *buffer, size_t length) {
+    std::vector<uint8_t> &value = store()[_name + "/" + key];
+    if (value.empty() || value.size() > length) {
+      return 0;
+    }
+    memcpy(buffer, value.data(), value.size());
+    return value.size();
+  }
+
+  size_t putBytes(const char *key, const void *buffer, size_t length) {
+    if (_read_only) {
+      return 0;
+    }
+    const uint8_t *bytes = (const uint8_t *)buffer;
+    store()[_name + "/" + key].assign(bytes, bytes + length);
+    return length;
+  }
+
+  static void simClear() {
+    store().clear();
+  }
+
+private:
+  std::string _name;
+  bool _read_only;
+
+  static std::map<std::string, std::vector<uint8_t>> &store() {
+    static std::map<std::string, std::vector<uint8_t>> values;
+    return values;
+  }
+};
+
+#endif
@@ -0,0 +1,161 @@
+/*
+  Simulated TwoWire with register devices on it, standing in for the
+  Wire library on the host.
+
+  A SimI2CDevice behaves like most register-mapped parts, the MAX7314
+  included: the first byte written sets the register pointer, further
+  bytes are written from there, and reads continue from the pointer.
+  Both auto-increment. A device that is not present NACKs its address.
+
+  Every transfer is logged with the clock it ran at and the task that
+  ran it, and takes transfer_us of real time so that tasks really do
+  contend for the bus.
+*/
+
+#ifndef SIM_WIRE_H
+#define SIM_WIRE_H
+
+#include "Arduino.h"
+#include <map>
+#include <vector>
+
+struct SimI2CDevice {
+  bool present;
+  uint8_t registers[256];
+  uint8_t pointer;
+
+  SimI2CDevice()
+    : present(true), pointer(0) {
+    memset(registers, 0, sizeof(registers));
+  }
+};
+
+struct SimI2CTransfer {
+  uint8_t address;
+  bool read;
+  uint8_t length;
+  uint32_t clock_hz;
+  TaskHandle_t task;
+};
+
+class TwoWire {
+public:
+  TwoWire()
+    : transfer_us(200), _clock_hz(100000), _address(0), _rx_position(0), _owner(NULL) {}
+
+  std::map<uint8_t, SimI2CDevice> sim_devices;
+  std::vector<SimI2CTransfer> sim_log;
+  // Set when two tasks used the bus at once, which I2CBus must prevent
+  bool sim_overlap = false;
+  uint32_t transfer_us;
+
+  bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0) {
+    return true;
+  }
+
+  void setClock(uint32_t clock_hz) {
+    _clock_hz = clock_hz;
+  }
+
+  void beginTransmission(uint8_t address) {
+    enter();
+    _address = address;
+    _tx.clear();
+  }
+
+  size_t write(uint8_t value) {
+    _tx.push_back(value);
+    return 1;
+  }
+
+  size_t write(const uint8_t *data, size_t length) {
+    _tx.insert(_tx.end(), data, data + length);
+    return length;
+  }
+
+  uint8_t endTransmission(bool send_stop = true) {
+    SimI2CDevice *device = find(_address);
+    log(_address, false, _tx.size());
+    if (device != NULL && !_tx.empty()) {
+      device->pointer = _tx[0];
+      for (size_t i = 1; i < _tx.size(); i++) {
+        device->registers[device->pointer++] = _tx[i];
+      }
+    }
+    leave();
+    // 2: address NACK, as the ESP32 core reports it
+    return device != NULL ? 0 : 2;
+  }
+
+  uint8_t requestFrom(uint8_t address, uint8_t length) {
+    enter();
+    SimI2CDevice *device = find(address);
+    log(address, true, length);
+    _rx.clear();
+    _rx_position = 0;
+    if (device != NULL) {
+      for (uint8_t i = 0; i < length; i++) {
+        _rx.push_back(device->registers[device->pointer++]);
+      }
+    }
+    leave();
+    return _rx.size();
+  }
+
+  int available() {
+    return _rx.size() - _rx_position;
+  }
+
+  int read() {
+    return _rx_position < _rx.size() ? _rx[_rx_position++] : -1;
+  }
+
+  /**
+   * @brief Transfers logged so far, safe to call while tasks run.
+   */
+  std::vector<SimI2CTransfer> simLog() {
+    std::lock_guard<std::mutex> lock(_log_mutex);
+    return sim_log;
+  }
+
+private:
+  uint32_t _clock_hz;
+  uint8_t _address;
+  std::vector<uint8_t> _tx;
+  std::vector<uint8_t> _rx;
+  size_t _rx_position;
+  TaskHandle_t _owner;
+  std::mutex _log_mutex;
+
+  SimI2CDevice *find(uint8_t address) {
+    std::map<uint8_t, SimI2CDevice>::iterator it = sim_devices.find(address);
+    return it != sim_devices.end() && it->second.present ? &it->second : NULL;
+  }
+
+  void enter() {
+    std::lock_guard<std::mutex> lock(_log_mutex);
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    if (_owner != NULL && _owner != self) {
+      sim_overlap = true;
+    }
+    _owner = self;
+  }
+
+  void leave() {
+    std::this_thread::sleep_for(std::chrono::microseconds(transfer_us));
+    std::lock_guard<std::mutex> lock(_log_mutex);
+    _owner = NULL;
+  }
+
+  void log(uint8_t address, bool read, size_t length) {
+    std::lock_guard<std::mutex> lock(_log_mutex);
+    SimI2CTransfer transfer = { address, read, (uint8_t)length, _clock_hz, xTaskGetCurrentTaskHandle() };
+    sim_log.push_back(transfer);
+  }
+};
+
+// Defined by each check that uses them
+extern TwoWire Wire;
+extern TwoWire Wire1;
+
+#endif
@@ -0,0 +1,231 @@
+/*
+  Runs DS18B20_Bus against the simulated OneWire bus in this directory.
+
+  Build and run from the repository root:
+    g++ -std=gnu++11 -Wall -Itools/sim -o /tmp/ds18b20_check \
+      tools/sim/ds18b20_check.cpp liquid_temp_test/ds18b20_bus.cpp
+    /tmp/ds18b20_check
+
+  Prints every failed check and exits with the number of failures.
+*/
+
+#include "Arduino.h"
+#include "OneWire.h"
+#include "Preferences.h"
+#include "../../liquid_temp_test/ds18b20_bus.h"
+
+std::atomic<uint64_t> sim_now_us(0);
+int sim_failures = 0;
+
+// Runs poll() until the conversion has been read, in 1 ms steps
+static uint32_t pollUntilDone(DS18B20_Bus &ds) {
+  uint32_t start = millis();
+  while (!ds.poll()) {
+    simAdvanceMs(1);
+    if (millis() - start > 2000) {
+      break;
+    }
+  }
+  return millis() - start;
+}
+
+static void checkSearchAndSavedRoms() {
+  Preferences::simClear();
+  OneWire bus(15);
+  bus.simAdd(1, 21500);
+  bus.simAdd(2, -3250);
+  bus.simAdd(3, 40000);
+
+  DS18B20_Bus ds;
+  SIM_CHECK(ds.begin(&bus, DS18B20_RESOLUTION_12_BIT) == 3);
+  SIM_CHECK(ds.scanCount() == 1);
+  SIM_CHECK(ds.rom(1)[1] == 2);
+
+  // The next boot finds the ROMs in NVS and does not search
+  DS18B20_Bus rebooted;
+  SIM_CHECK(rebooted.begin(&bus, DS18B20_RESOLUTION_12_BIT) == 3);
+  SIM_CHECK(rebooted.scanCount() == 0);
+}
+
+static void checkConvertAll() {
+  Preferences::simClear();
+  OneWire bus(15);
+  bus.simAdd(1, 21500);
+  bus.simAdd(2, -3250);
+  bus.simAdd(3, 40000);
+  for (size_t i = 0; i < bus.sim_devices.size(); i++) {
+    bus.sim_devices[i].conversion_us = 150000;
+  }
+
+  DS18B20_Bus ds;
+  ds.begin(&bus, DS18B20_RESOLUTION_10_BIT);
+  SIM_CHECK(ds.conversionTimeMs() == 188);
+  for (size_t i = 0; i < bus.sim_devices.size(); i++) {
+    SIM_CHECK(bus.sim_devices[i].resolution() == 10);
+  }
+
+  // One command converts every sensor
+  SIM_CHECK(ds.startConversion());
+  SIM_CHECK(ds.busy());
+  SIM_CHECK(!ds.startConversion());
+  for (size_t i = 0; i < bus.sim_devices.size(); i++) {
+    SIM_CHECK(bus.sim_devices[i].conversions == 1);
+  }
+
+  // Externally powered sensors report done before the worst case
+  uint32_t took_ms = pollUntilDone(ds);
+  SIM_CHECK(took_ms >= 150 && took_ms < 188);
+  SIM_CHECK(!ds.busy());
+
+  // The undefined low bits at 10 bit are masked off
+  SIM_CHECK(ds.valid(0) && ds.temperatureMilli(0) == 21500);
+  SIM_CHECK(ds.valid(1) && ds.temperatureMilli(1) == -3250);
+  SIM_CHECK(ds.valid(2) && ds.temperatureMilli(2) == 40000);
+}
+
+static void checkParasitePower() {
+  Preferences::simClear();
+  OneWire bus(15);
+  bus.simAdd(1, 25000).parasite = true;
+  bus.sim_devices[0].conversion_us = 50000;
+
+  // Parasite powered sensors can't signal done, the worst case applies
+  DS18B20_Bus ds;
+  ds.begin(&bus, DS18B20_RESOLUTION_9_BIT);
+  ds.startConversion();
+  uint32_t took_ms = pollUntilDone(ds);
+  SIM_CHECK(took_ms >= ds.conversionTimeMs());
+  SIM_CHECK(ds.valid(0) && ds.temperatureMilli(0) == 25000);
+}
+
+static void checkCrcAndRescan() {
+  Preferences::simClear();
+  OneWire bus(15);
+  bus.simAdd(1, 20000);
+  bus.simAdd(2, 30000);
+
+  DS18B20_Bus ds;
+  ds.begin(&bus, DS18B20_RESOLUTION_12_BIT);
+  SIM_CHECK(ds.scanCount() == 1);
+
+  // A corrupted read fails its CRC and is not reported
+  bus.sim_devices[0].corrupt_reads = 1;
+  ds.startConversion();
+  pollUntilDone(ds);
+  SIM_CHECK(!ds.valid(0));
+  SIM_CHECK(ds.valid(1));
+  ds.startConversion();
+  pollUntilDone(ds);
+  SIM_CHECK(ds.valid(0) && ds.temperatureMilli(0) == 20000);
+
+  // A sensor that is gone reads all 0xFF. A few failures in a row
+  // trigger a rescan, which drops it.
+  bus.sim_devices[0].present = false;
+  for (uint8_t i = 0; i < DS18B20_RESCAN_AFTER_FAILURES; i++) {
+    ds.startConversion();
+    pollUntilDone(ds);
+    SIM_CHECK(!ds.valid(0));
+  }
+  SIM_CHECK(ds.scanCount() == 1);
+  ds.startConversion();
+  SIM_CHECK(ds.scanCount() == 2);
+  SIM_CHECK(ds.deviceCount() == 1);
+  pollUntilDone(ds);
+  SIM_CHECK(ds.valid(0) && ds.temperatureMilli(0) == 30000);
+}
+
+static void checkResolutionSurvivesPowerCycle() {
+  Preferences::simClear();
+  OneWire bus(15);
+  bus.simAdd(1, 20000).conversion_us = 90000;
+
+  DS18B20_Bus ds;
+  ds.begin(&bus, DS18B20_RESOLUTION_9_BIT);
+  SIM_CHECK(bus.sim_devices[0].copies == 1);
+
+  // Without the copy to EEPROM it would come back at 12 bit
+  bus.sim_devices[0].powerCycle();
+  SIM_CHECK(bus.sim_devices[0].resolution() == 9);
+}
+
+static void checkCopyOnlyWhenChanged() {
+  Preferences::simClear();
+  OneWire bus(15);
+  bus.simAdd(1, 20000);
+  bus.simAdd(2, 21000);
+  // Already at 10 bit from an earlier run
+  SimDS18B20 &set_up = bus.simAdd(3, 22000);
+  set_up.eeprom[2] = 0x3F;
+  set_up.powerCycle();
+
+  DS18B20_Bus ds;
+  SIM_CHECK(ds.begin(&bus, DS18B20_RESOLUTION_10_BIT) == 3);
+  SIM_CHECK(bus.sim_devices[0].copies == 1);
+  SIM_CHECK(bus.sim_devices[1].copies == 1);
+  SIM_CHECK(bus.sim_devices[2].copies == 0);
+
+  // Neither a reboot nor a rescan writes the EEPROM again
+  for (size_t i = 0; i < bus.sim_devices.size(); i++) {
+    bus.sim_devices[i].powerCycle();
+  }
+  DS18B20_Bus rebooted;
+  rebooted.begin(&bus, DS18B20_RESOLUTION_10_BIT);
+  rebooted.rescan();
+  SIM_CHECK(rebooted.setResolution(DS18B20_RESOLUTION_10_BIT));
+  for (size_t i = 0; i < bus.sim_devices.size(); i++) {
+    SIM_CHECK(bus.sim_devices[i].resolution() == 10);
+  }
+  SIM_CHECK(bus.sim_devices[0].copies == 1 && bus.sim_devices[1].copies == 1);
+  SIM_CHECK(bus.sim_devices[2].copies == 0);
+
+  // A replacement sensor at the 12 bit default is the only one written
+  bus.sim_devices[1].eeprom[2] = 0x7F;
+  bus.sim_devices[1].powerCycle();
+  SIM_CHECK(rebooted.setResolution(DS18B20_RESOLUTION_10_BIT));
+  SIM_CHECK(bus.sim_devices[0].copies == 1 && bus.sim_devices[1].copies == 2);
+  SIM_CHECK(bus.sim_devices[1].resolution() == 10);
+}
+
+static void checkStuckLowBus() {
+  Preferences::simClear();
+  OneWire bus(15);
+  bus.simAdd(1, 20000);
+
+  DS18B20_Bus ds;
+  ds.begin(&bus, DS18B20_RESOLUTION_12_BIT);
+
+  // All zeros pass the CRC, but must not read as 0 C
+  bus.sim_reads_stuck_low = true;
+  ds.startConversion();
+  pollUntilDone(ds);
+  SIM_CHECK(!ds.valid(0));
+}
+
+static void checkEmptyBus() {
+  Preferences::simClear();
+  OneWire bus(15);
+
+  DS18B20_Bus ds;
+  SIM_CHECK(ds.begin(&bus, DS18B20_RESOLUTION_12_BIT) == 0);
+  SIM_CHECK(!ds.startConversion());
+  SIM_CHECK(!ds.busy());
+
+  // Sensors plugged in later are found by the next attempt
+  bus.simAdd(1, 22000);
+  SIM_CHECK(ds.startConversion());
+  SIM_CHECK(ds.deviceCount() == 1);
+}
+
+int main() {
+  checkSearchAndSavedRoms();
+  checkConvertAll();
+  checkParasitePower();
+  checkCrcAndRescan();
+  checkResolutionSurvivesPowerCycle();
+  checkCopyOnlyWhenChanged();
+  checkStuckLowBus();
+  checkEmptyBus();
+
+  printf("ds18b20_check: %d failed\n", sim_failures);
+  return sim_failures;
+}
@@ -0,0 +1,122 @@
+/*
+  Times one acquisition cycle with every device on one I2C controller,
+  and with temp_acquisition's Board splitting the expanders and the
+  sensors over both controllers.
+
+  Build and run from the repository root:
+    g++ -std=gnu++11 -Wall -pthread -Itools/sim -o /tmp/dual_bus_check \
+      tools/sim/dual_bus_check.cpp temp_acquisition/src/Board/Board.cpp \
+      temp_acquisition/src/I2CBus/I2CBus.cpp
+    /tmp/dual_bus_check
+
+  A cycle is what temp_acquisition.ino's benchmark() times: the expander
+  inputs are read on the expander bus worker while this task selects
+  each TSYS01 on the mux and reads its ADC. Every simulated transfer
+  takes transfer_us of real time, so the two controllers really do run
+  at the same time. Prints both cycle times and fails if the two
+  controller setup is not faster, or if either bus was used by two
+  tasks at once.
+
+  Prints every failed check and exits with the number of failures.
+*/
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "../../temp_acquisition/src/Board/Board.hpp"
+
+std::atomic<uint64_t> sim_now_us(0);
+int sim_failures = 0;
+TwoWire Wire;
+TwoWire Wire1;
+
+#define CYCLES 20
+#define TSYS01_COUNT 2
+#define TSYS01_ADC_READ 0x00
+
+struct Completion {
+  std::atomic<uint32_t> calls;
+};
+
+static void completed(I2CRequest *request) {
+  ((Completion *)request->context)->calls++;
+}
+
+static void addDevices(TwoWire &expanders, TwoWire &sensors) {
+  expanders.sim_devices[BOARD_EXPANDER_1_ADDRESS];
+  expanders.sim_devices[BOARD_EXPANDER_2_ADDRESS];
+  sensors.sim_devices[BOARD_MUX_ADDRESS];
+  sensors.sim_devices[BOARD_TSYS01_ADDRESS];
+}
+
+// One cycle, returns its time in real microseconds
+static uint32_t cycle(I2CBus *expanders, I2CBus *sensors) {
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  // The input read goes to the expander bus worker, like readPinsAsync()
+  uint8_t input_register = 0x00;
+  uint8_t inputs[2];
+  Completion completion = { { 0 } };
+  I2CRequest read = { BOARD_EXPANDER_1_ADDRESS, &input_register, 1, inputs, 2,
+                      I2C_PRIORITY_NORMAL, completed, &completion, NULL, 0, 0 };
+  SIM_CHECK(expanders->submit(&read));
+
+  // Meanwhile the sensors, one mux channel at a time
+  for (uint8_t i = 0; i < TSYS01_COUNT; i++) {
+    uint8_t channel = 1 << i;
+    I2CTransaction transaction(sensors, BOARD_MUX_ADDRESS);
+    TwoWire *wire = sensors->wire();
+    wire->beginTransmission(BOARD_MUX_ADDRESS);
+    wire->write(channel);
+    SIM_CHECK(wire->endTransmission() == 0);
+    uint8_t adc[3];
+    SIM_CHECK(sensors->writeRead(BOARD_TSYS01_ADDRESS, TSYS01_ADC_READ, adc, 3) == 3);
+  }
+
+  // Not vTaskDelay(), a whole tick would swamp the transfer times
+  while (completion.calls == 0) {
+    std::this_thread::yield();
+  }
+  SIM_CHECK(read.status == I2C_OK);
+
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+           std::chrono::steady_clock::now() - start).count();
+}
+
+static uint32_t meanCycleUs(I2CBus *expanders, I2CBus *sensors) {
+  uint64_t total_us = 0;
+  for (uint8_t i = 0; i < CYCLES; i++) {
+    total_us += cycle(expanders, sensors);
+  }
+  return total_us / CYCLES;
+}
+
+int main() {
+  // Everything on one controller, the way it was before Board
+  TwoWire single_wire;
+  addDevices(single_wire, single_wire);
+  I2CBus single;
+  single.begin(&single_wire);
+  SIM_CHECK(single.startWorker(0));
+  uint32_t serial_us = meanCycleUs(&single, &single);
+
+  // Board puts the expanders on Wire and the mux and sensors on Wire1
+  addDevices(Wire, Wire1);
+  Board board;
+  SIM_CHECK(board.begin());
+  SIM_CHECK(board.busFor(BOARD_EXPANDER_1) != board.busFor(BOARD_TSYS01));
+  SIM_CHECK(board.busFor(BOARD_MUX) == board.busFor(BOARD_TSYS01));
+  uint32_t parallel_us = meanCycleUs(board.busFor(BOARD_EXPANDER_1), board.busFor(BOARD_TSYS01));
+
+  SIM_CHECK(!single_wire.sim_overlap && !Wire.sim_overlap && !Wire1.sim_overlap);
+  // Both controllers' transfers must have overlapped at least partly
+  SIM_CHECK(parallel_us < serial_us);
+
+  printf("one controller:  %u us/cycle\n", serial_us);
+  printf("two controllers: %u us/cycle\n", parallel_us);
+  // The input read and each ADC read are a write and a read each
+  printf("%u transfers of %u us each per cycle\n",
+         2 + 3 * TSYS01_COUNT, single_wire.transfer_us);
+
+  printf("dual_bus_check: %d failed\n", sim_failures);
+  return sim_failures;
+}
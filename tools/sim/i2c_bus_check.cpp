@@ -0,0 +1,254 @@
+/*
+  Runs I2CBus against the simulated TwoWire and FreeRTOS in this
+  directory, with real threads contending for the bus.
+
+  Build and run from the repository root:
+    g++ -std=gnu++11 -Wall -pthread -Itools/sim -o /tmp/i2c_bus_check \
+      tools/sim/i2c_bus_check.cpp temp_acquisition/src/I2CBus/I2CBus.cpp
+    /tmp/i2c_bus_check
+
+  Prints every failed check and exits with the number of failures.
+*/
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "../../temp_acquisition/src/I2CBus/I2CBus.hpp"
+
+std::atomic<uint64_t> sim_now_us(0);
+int sim_failures = 0;
+
+#define EXPANDER 0x20
+#define MUX 0x70
+
+// Waits in real time for a condition another task makes true
+template<typename Condition>
+static bool waitFor(Condition condition, uint32_t timeout_ms = 1000) {
+  for (uint32_t i = 0; i < timeout_ms; i++) {
+    if (condition()) {
+      return true;
+    }
+    vTaskDelay(1);
+  }
+  return condition();
+}
+
+struct Contender {
+  I2CBus *bus;
+  uint8_t priority;
+  // Order the contenders got the bus in, shared by all of them
+  std::vector<uint8_t> *order;
+  std::mutex *order_mutex;
+  std::atomic<bool> done;
+};
+
+static void contend(void *context) {
+  Contender *contender = (Contender *)context;
+  {
+    I2CTransaction transaction(contender->bus, EXPANDER, contender->priority);
+    std::lock_guard<std::mutex> lock(*contender->order_mutex);
+    contender->order->push_back(contender->priority);
+  }
+  contender->done = true;
+  for (;;) {
+    vTaskDelay(1000);
+  }
+}
+
+static void checkWriteReadAndClocks() {
+  TwoWire wire;
+  wire.sim_devices[EXPANDER].registers[0x00] = 0xA5;
+  wire.sim_devices[EXPANDER].registers[0x01] = 0x5A;
+  wire.sim_devices[MUX];
+
+  I2CBus bus;
+  bus.begin(&wire);
+  bus.setDeviceClock(EXPANDER, 400000);
+
+  uint8_t pins[2] = { 0, 0 };
+  SIM_CHECK(bus.writeRead(EXPANDER, 0x00, pins, 2) == 2);
+  SIM_CHECK(pins[0] == 0xA5 && pins[1] == 0x5A);
+
+  // Two transfers per read, then the clock only changes with the device
+  bus.writeRead(EXPANDER, 0x00, pins, 2);
+  bus.writeRead(MUX, 0x00, pins, 1);
+  std::vector<SimI2CTransfer> log = wire.simLog();
+  SIM_CHECK(log.size() == 6);
+  SIM_CHECK(log[0].clock_hz == 400000 && log[3].clock_hz == 400000);
+  SIM_CHECK(log[4].clock_hz == 100000);
+  SIM_CHECK(bus.stats().clock_changes == 2);
+  SIM_CHECK(bus.stats().transactions == 3);
+
+  // A missing device reads nothing
+  SIM_CHECK(bus.writeRead(0x21, 0x00, pins, 2) == 0);
+}
+
+static void checkNestedTransactions() {
+  TwoWire wire;
+  wire.sim_devices[EXPANDER];
+  wire.sim_devices[MUX];
+
+  I2CBus bus;
+  bus.begin(&wire);
+
+  // A mux guard around a sensor read, on one task, must not deadlock
+  uint8_t value;
+  {
+    I2CTransaction outer(&bus, MUX);
+    {
+      I2CTransaction inner(&bus, EXPANDER);
+      SIM_CHECK(bus.writeRead(EXPANDER, 0x00, &value, 1) == 1);
+    }
+    SIM_CHECK(bus.writeRead(MUX, 0x00, &value, 1) == 1);
+  }
+  // Counted as the one outer transaction
+  SIM_CHECK(bus.stats().transactions == 1);
+  SIM_CHECK(bus.stats().contended == 0);
+}
+
+static void checkPriorityHandoff() {
+  TwoWire wire;
+  wire.sim_devices[EXPANDER];
+
+  I2CBus bus;
+  bus.begin(&wire);
+
+  std::vector<uint8_t> order;
+  std::mutex order_mutex;
+  Contender low = { &bus, I2C_PRIORITY_LOW, &order, &order_mutex, { false } };
+  Contender normal = { &bus, I2C_PRIORITY_NORMAL, &order, &order_mutex, { false } };
+  Contender high = { &bus, I2C_PRIORITY_HIGH, &order, &order_mutex, { false } };
+
+  // Queue them up behind a transaction held here, lowest priority first
+  {
+    I2CTransaction held(&bus, EXPANDER);
+    Contender *contenders[] = { &low, &normal, &high };
+    for (uint8_t i = 0; i < 3; i++) {
+      xTaskCreatePinnedToCore(contend, "contend", 2048, contenders[i], 1, NULL, 0);
+      uint8_t depth = i + 1;
+      SIM_CHECK(waitFor([&bus, depth]() { return bus.depth() == depth; }));
+    }
+    SIM_CHECK(order.empty());
+  }
+
+  SIM_CHECK(waitFor([&]() { return low.done && normal.done && high.done; }));
+  SIM_CHECK(order.size() == 3);
+  SIM_CHECK(order.size() == 3 && order[0] == I2C_PRIORITY_HIGH
+            && order[1] == I2C_PRIORITY_NORMAL && order[2] == I2C_PRIORITY_LOW);
+  SIM_CHECK(bus.depth() == 0);
+  SIM_CHECK(bus.stats().contended == 3);
+  SIM_CHECK(bus.stats().max_depth == 3);
+}
+
+struct Completion {
+  std::atomic<uint32_t> calls;
+  TaskHandle_t task;
+};
+
+static void completed(I2CRequest *request) {
+  Completion *completion = (Completion *)request->context;
+  completion->task = xTaskGetCurrentTaskHandle();
+  completion->calls++;
+}
+
+static void checkAsyncRequests() {
+  TwoWire wire;
+  wire.sim_devices[EXPANDER].registers[0x02] = 0x3C;
+
+  I2CBus bus;
+  bus.begin(&wire);
+  SIM_CHECK(bus.startWorker(0));
+
+  // Write the output register, then read it back, both on the worker
+  uint8_t write_tx[] = { 0x02, 0xC3 };
+  uint8_t read_tx[] = { 0x02 };
+  uint8_t rx[1] = { 0 };
+  Completion completion = { { 0 }, NULL };
+  I2CRequest write = { EXPANDER, write_tx, 2, NULL, 0, I2C_PRIORITY_NORMAL,
+                       completed, &completion, NULL, 0, 0 };
+  I2CRequest read = { EXPANDER, read_tx, 1, rx, 1, I2C_PRIORITY_NORMAL,
+                      completed, &completion, NULL, 0, 0 };
+  SIM_CHECK(bus.submit(&write));
+  SIM_CHECK(bus.submit(&read));
+  SIM_CHECK(waitFor([&]() { return completion.calls == 2; }));
+  SIM_CHECK(write.status == I2C_OK);
+  SIM_CHECK(read.status == I2C_OK && read.rx_received == 1 && rx[0] == 0xC3);
+  SIM_CHECK(completion.task != xTaskGetCurrentTaskHandle());
+
+  // The worker takes the bus like any other task, and the queue refuses
+  // requests once full instead of blocking the caller
+  I2CRequest queued[I2C_BUS_QUEUE_LENGTH + 2];
+  uint8_t accepted = 0;
+  bool refused = false;
+  {
+    I2CTransaction held(&bus, EXPANDER);
+    for (uint8_t i = 0; i < I2C_BUS_QUEUE_LENGTH + 2; i++) {
+      queued[i] = read;
+      if (bus.submit(&queued[i])) {
+        accepted++;
+      } else {
+        refused |= queued[i].status == I2C_QUEUE_FULL;
+      }
+      // Let the worker take the first one and block on the bus
+      SIM_CHECK(waitFor([&bus]() { return bus.depth() == 1; }));
+    }
+  }
+  SIM_CHECK(refused);
+  SIM_CHECK(accepted == I2C_BUS_QUEUE_LENGTH + 1);
+  SIM_CHECK(waitFor([&]() { return completion.calls == 2u + accepted; }));
+  SIM_CHECK(!wire.sim_overlap);
+}
+
+static void checkDeviceHealth() {
+  TwoWire wire;
+  wire.sim_devices[EXPANDER].present = false;
+
+  I2CBus bus;
+  bus.begin(&wire);
+
+  I2CDeviceHealth health;
+  uint8_t tx[] = { 0x00 };
+  uint8_t rx[1];
+  I2CRequest request = { EXPANDER, tx, 1, rx, 1, I2C_PRIORITY_NORMAL,
+                         NULL, NULL, &health, 0, 0 };
+
+  // Every failure costs a transfer until the device is taken offline
+  for (uint8_t i = 0; i < I2C_HEALTH_FAIL_LIMIT; i++) {
+    bus.execute(&request);
+    SIM_CHECK(request.status == I2C_NACK);
+  }
+  SIM_CHECK(!health.online());
+  SIM_CHECK(health.dropouts() == 1);
+
+  // Offline requests fail at once, without touching the bus
+  size_t transfers = wire.simLog().size();
+  bus.execute(&request);
+  SIM_CHECK(request.status == I2C_OFFLINE);
+  SIM_CHECK(!bus.submit(&request) && request.status == I2C_OFFLINE);
+  SIM_CHECK(wire.simLog().size() == transfers);
+
+  // A failed probe doubles the wait
+  simAdvanceMs(I2C_HEALTH_RETRY_MIN_MS);
+  bus.execute(&request);
+  SIM_CHECK(request.status == I2C_NACK);
+  simAdvanceMs(I2C_HEALTH_RETRY_MIN_MS);
+  SIM_CHECK(!health.ready());
+  simAdvanceMs(I2C_HEALTH_RETRY_MIN_MS);
+  SIM_CHECK(health.ready());
+
+  // One good probe brings it back
+  wire.sim_devices[EXPANDER].present = true;
+  bus.execute(&request);
+  SIM_CHECK(request.status == I2C_OK);
+  SIM_CHECK(health.online() && health.failures() == 0);
+}
+
+int main() {
+  checkWriteReadAndClocks();
+  checkNestedTransactions();
+  checkPriorityHandoff();
+  checkAsyncRequests();
+  checkDeviceHealth();
+
+  printf("i2c_bus_check: %d failed\n", sim_failures);
+  return sim_failures;
+}
@@ -0,0 +1,87 @@
+/*
+  Per call cost of the MAX7314 driver's DEBUG logging, built once with
+  the DRIVER level at DEBUG and once at NONE. log_level_cost.sh builds
+  and runs both, and compares the drivers' code size.
+
+  Build and run one level by hand from the repository root:
+    g++ -std=gnu++11 -Os -Wall -pthread -Itools/sim \
+      -DLOG_LEVEL_DRIVER=LOG_LEVEL_DEBUG -o /tmp/log_level_cost \
+      tools/sim/log_level_cost.cpp max_7314/src/max7314.cpp \
+      max_7314/src/I2CBus.cpp max_7314/src/DeferredLog.cpp
+    /tmp/log_level_cost
+
+  The simulated bus takes no time here, so the timings are the driver
+  and its logging alone. Host nanoseconds, not ESP32 cycles: compare
+  the two levels with each other, not with the target.
+
+  Prints every failed check and exits with the number of failures.
+*/
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "HardwareSerial.h"
+#include "../../max_7314/src/max7314.h"
+#include "../../max_7314/src/DeferredLog.hpp"
+#include "../../max_7314/src/LogLevel.hpp"
+
+std::atomic<uint64_t> sim_now_us(0);
+int sim_failures = 0;
+TwoWire Wire;
+
+#define CALLS 100000
+// Calls between drains, well below DEFERRED_LOG_RECORDS
+#define BATCH 16
+
+static const char *levelName() {
+  return LOG_ENABLED(DRIVER, DEBUG) ? "DEBUG" : LOG_ENABLED(DRIVER, INFO) ? "INFO"
+         : LOG_ENABLED(DRIVER, WARN) ? "WARN" : LOG_ENABLED(DRIVER, ERROR) ? "ERROR" : "NONE";
+}
+
+int main() {
+  Wire.transfer_us = 0;
+  Wire.sim_devices[EXPANDER_1];
+  HardwareSerial out(0);
+  out.begin(2000000);
+
+  MAX7314 expander;
+  expander.init(&Wire, EXPANDER_1, NULL, 0);
+
+  // The fastest batch, the others include whatever else the host did
+  uint64_t best_ns = UINT64_MAX;
+  uint32_t drained = 0;
+  for (uint32_t done = 0; done < CALLS; done += BATCH) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (uint8_t i = 0; i < BATCH; i++) {
+      if (i & 1) {
+        expander.clearStaticOutputs(STATIC_PIN3);
+      } else {
+        expander.setStaticOutputs(STATIC_PIN3);
+      }
+    }
+    uint64_t batch_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - start).count();
+    if (batch_ns < best_ns) {
+      best_ns = batch_ns;
+    }
+    Wire.sim_log.clear();
+
+    // Outside the timing, like draining in idle time. Each pass sends
+    // what fits in the UART FIFO, which empties in a millisecond.
+    uint8_t sent;
+    do {
+      simAdvanceMs(1);
+      sent = Log.drain(out);
+      drained += sent;
+    } while (sent > 0);
+  }
+
+  // Every call logs at DEBUG, none do below it
+  SIM_CHECK(Log.dropped() == 0);
+  SIM_CHECK(drained == (LOG_ENABLED(DRIVER, DEBUG) ? CALLS : 0));
+
+  printf("DRIVER %-5s %6.1f ns per setStaticOutputs() / clearStaticOutputs()\n",
+         levelName(), (double)best_ns / BATCH);
+
+  printf("log_level_cost: %d failed\n", sim_failures);
+  return sim_failures;
+}
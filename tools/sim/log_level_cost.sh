@@ -0,0 +1,36 @@
+#!/bin/sh
+# Builds the drivers with their module's log level at DEBUG and at NONE,
+# and prints the code size of each and the per call cost of the MAX7314
+# driver's logging. Run from the repository root.
+#
+# Host -Os objects, not the ESP32 firmware: the difference between the
+# two levels is what carries over, not the absolute numbers.
+
+set -e
+out=${TMPDIR:-/tmp}/log_level_cost
+mkdir -p "$out"
+
+size_of() {
+  # text + data of one object
+  size "$1" | awk 'NR == 2 { print $1 + $2 }'
+}
+
+for level in DEBUG NONE; do
+  g++ -std=gnu++11 -Os -Wall -Itools/sim -DLOG_LEVEL_DRIVER=LOG_LEVEL_$level \
+    -c -o "$out/max7314_$level.o" max_7314/src/max7314.cpp
+  g++ -std=gnu++11 -Os -Wall -Itools/sim -DLOG_LEVEL_SENSOR=LOG_LEVEL_$level \
+    -c -o "$out/tsys01_$level.o" tsys01/tsys01.cpp
+done
+
+printf '%-24s %8s %8s\n' "bytes" DEBUG NONE
+printf '%-24s %8s %8s\n' "max_7314/src/max7314.cpp" \
+  "$(size_of "$out/max7314_DEBUG.o")" "$(size_of "$out/max7314_NONE.o")"
+printf '%-24s %8s %8s\n' "tsys01/tsys01.cpp" \
+  "$(size_of "$out/tsys01_DEBUG.o")" "$(size_of "$out/tsys01_NONE.o")"
+
+for level in DEBUG NONE; do
+  g++ -std=gnu++11 -Os -Wall -pthread -Itools/sim -DLOG_LEVEL_DRIVER=LOG_LEVEL_$level \
+    -o "$out/log_level_cost_$level" tools/sim/log_level_cost.cpp max_7314/src/max7314.cpp \
+    max_7314/src/I2CBus.cpp max_7314/src/DeferredLog.cpp
+  "$out/log_level_cost_$level"
+done
@@ -0,0 +1,234 @@
+/*
+  Runs RS485Port against the simulated HardwareSerial in this directory
+  and times its driver enable (DE) turnaround.
+
+  Build and run from the repository root:
+    g++ -std=gnu++11 -Wall -pthread -Itools/sim -o /tmp/rs485_check \
+      tools/sim/rs485_check.cpp modbus_basic/src/RS485/RS485Port.cpp
+    /tmp/rs485_check
+
+  Each check sends a Modbus request and compares when DE dropped with
+  when the simulated UART sent the last stop bit, for a plain DE pin,
+  the UART's own DE and DE behind a slow expander write. DE must not drop
+  before it, and may only stay up about a bit time past it. The port's
+  own stats() have to agree with what the check saw on the pin.
+
+  Prints every failed check and exits with the number of failures.
+*/
+
+#include "Arduino.h"
+#include "HardwareSerial.h"
+#include "../../modbus_basic/src/RS485/RS485Port.hpp"
+
+std::atomic<uint64_t> sim_now_us(0);
+int sim_failures = 0;
+
+#define BAUD 19200
+#define DE_PIN 13
+
+static const uint8_t kRequest[8] = { 0x01, 0x04, 0x00, 0x00, 0x00, 0x02, 0x71, 0xCB };
+
+static uint32_t bitUs() {
+  return (1000000 + BAUD - 1) / BAUD;
+}
+
+static uint32_t endUs(HardwareSerial &uart) {
+  return (uint32_t)((uart.simTxEndNs() + 999) / 1000);
+}
+
+static uint32_t wireUs(HardwareSerial &uart, uint32_t bytes) {
+  return (uint32_t)(bytes * uart.simByteNs() / 1000);
+}
+
+static void checkPlainPin() {
+  HardwareSerial uart(2);
+  RS485Port port;
+  SIM_CHECK(!port.begin(&uart, BAUD, SERIAL_8E1, 16, 17, DE_PIN));
+  SIM_CHECK(!port.hardwareDE());
+  SIM_CHECK(digitalRead(DE_PIN) == LOW);
+
+  simAdvanceMs(10);
+  uint32_t start_us = micros();
+  SIM_CHECK(port.write(kRequest, sizeof(kRequest)) == sizeof(kRequest));
+  SIM_CHECK(digitalRead(DE_PIN) == HIGH && simPins()[DE_PIN].changed_us == start_us);
+  port.flush();
+
+  // Dropped after the last stop bit, within a bit time of it
+  uint32_t fall_us = simPins()[DE_PIN].changed_us;
+  SIM_CHECK(digitalRead(DE_PIN) == LOW);
+  SIM_CHECK(fall_us >= endUs(uart));
+  SIM_CHECK(fall_us - endUs(uart) <= bitUs());
+
+  RS485Stats stats = port.stats();
+  uint32_t wire_us = wireUs(uart, sizeof(kRequest));
+  SIM_CHECK(stats.frames == 1);
+  SIM_CHECK(stats.last_de_us == fall_us - start_us);
+  SIM_CHECK(stats.last_overhead_us == stats.last_de_us - wire_us);
+  SIM_CHECK(stats.last_overhead_us <= bitUs());
+  SIM_CHECK(stats.switch_us == 0 && stats.switch_failures == 0);
+}
+
+static void checkHardwareDE() {
+  HardwareSerial uart(2);
+  uart.sim_rs485 = true;
+  RS485Port port;
+  SIM_CHECK(port.begin(&uart, BAUD, SERIAL_8E1, 16, 17, DE_PIN));
+
+  simAdvanceMs(10);
+  port.write(kRequest, sizeof(kRequest));
+  port.flush();
+
+  // The UART drops DE itself, flush() only returns once it has
+  SIM_CHECK(uart.sim_de_fall_us == endUs(uart));
+  SIM_CHECK(micros() >= uart.sim_de_fall_us);
+  SIM_CHECK(port.stats().last_overhead_us <= bitUs());
+}
+
+// DE on an expander pin: the write takes switch_us and the pin changes
+// when it completes
+struct ExpanderDE {
+  uint32_t switch_us;
+  bool fail;
+  bool high;
+  uint32_t changed_us;
+};
+
+static bool expanderDriveEnable(bool high, void *context) {
+  ExpanderDE *de = (ExpanderDE *)context;
+  simAdvanceUs(de->switch_us);
+  if (de->fail) {
+    return false;
+  }
+  if (de->high != high) {
+    de->high = high;
+    de->changed_us = micros();
+  }
+  return true;
+}
+
+static void checkExpanderDE() {
+  HardwareSerial uart(2);
+  ExpanderDE de = { 150, false, true, 0 };
+  RS485Port port;
+  port.begin(&uart, BAUD, SERIAL_8E1, 16, 17, expanderDriveEnable, &de);
+  SIM_CHECK(!de.high);
+
+  simAdvanceMs(10);
+  uint32_t start_us = micros();
+  port.write(kRequest, sizeof(kRequest));
+  // The frame only starts once DE is up
+  SIM_CHECK(de.high && de.changed_us == start_us + de.switch_us);
+  SIM_CHECK(uart.simTxEndNs() / 1000 >= de.changed_us);
+  port.flush();
+
+  // The release is started ahead of the end by the switch time, so DE
+  // drops on the last stop bit instead of a whole switch later
+  SIM_CHECK(!de.high);
+  SIM_CHECK(de.changed_us >= endUs(uart));
+  SIM_CHECK(de.changed_us - endUs(uart) <= bitUs());
+  SIM_CHECK(micros() >= endUs(uart));
+
+  // Raw overhead has both switches in it, net has neither
+  RS485Stats stats = port.stats();
+  uint32_t wire_us = wireUs(uart, sizeof(kRequest));
+  SIM_CHECK(stats.last_de_us == micros() - start_us);
+  SIM_CHECK(stats.last_overhead_us == stats.last_de_us - wire_us);
+  SIM_CHECK(stats.last_overhead_us >= de.switch_us);
+  SIM_CHECK(stats.last_net_overhead_us == 0);
+  SIM_CHECK(stats.switch_us == de.switch_us && stats.min_switch_us == de.switch_us);
+}
+
+static void checkExpanderLateFrame() {
+  // The task is preempted halfway through writing the frame. An open
+  // loop release timed from the first byte would cut off the rest.
+  HardwareSerial uart(2);
+  ExpanderDE de = { 150, false, false, 0 };
+  RS485Port port;
+  port.begin(&uart, BAUD, SERIAL_8E1, 16, 17, expanderDriveEnable, &de);
+
+  simAdvanceMs(10);
+  port.write(kRequest, 4);
+  simAdvanceMs(3);
+  port.write(kRequest + 4, 4);
+  port.flush();
+  SIM_CHECK(de.changed_us >= endUs(uart));
+  SIM_CHECK(de.changed_us - endUs(uart) <= bitUs());
+}
+
+static void checkExpanderSlowSwitch() {
+  // Slower than a character, the release starts once the FIFO is empty
+  // and DE drops a bit after the frame
+  HardwareSerial uart(2);
+  ExpanderDE de = { 800, false, false, 0 };
+  RS485Port port;
+  port.begin(&uart, BAUD, SERIAL_8E1, 16, 17, expanderDriveEnable, &de);
+
+  simAdvanceMs(10);
+  port.write(kRequest, sizeof(kRequest));
+  port.flush();
+  uint32_t char_us = (uint32_t)(uart.simByteNs() / 1000);
+  SIM_CHECK(de.changed_us >= endUs(uart));
+  SIM_CHECK(de.changed_us - endUs(uart) <= de.switch_us - char_us + bitUs());
+
+  // The estimate follows the fastest switch, so a faster one still
+  // can't drop DE early
+  de.switch_us = 100;
+  port.write(kRequest, sizeof(kRequest));
+  port.flush();
+  SIM_CHECK(de.changed_us >= endUs(uart));
+  SIM_CHECK(port.stats().min_switch_us == 100);
+}
+
+static void checkExpanderFailure() {
+  HardwareSerial uart(2);
+  ExpanderDE de = { 150, false, false, 0 };
+  RS485Port port;
+  port.begin(&uart, BAUD, SERIAL_8E1, 16, 17, expanderDriveEnable, &de);
+
+  // DE could not be raised, nothing may reach the UART
+  de.fail = true;
+  SIM_CHECK(port.write(kRequest, sizeof(kRequest)) == 0);
+  SIM_CHECK(port.write(kRequest[0]) == 0);
+  port.flush();
+  SIM_CHECK(uart.sim_bytes == 0);
+  SIM_CHECK(port.stats().frames == 0);
+  SIM_CHECK(port.stats().switch_failures == 2);
+
+  de.fail = false;
+  SIM_CHECK(port.write(kRequest, sizeof(kRequest)) == sizeof(kRequest));
+  port.flush();
+  SIM_CHECK(uart.sim_bytes == sizeof(kRequest));
+}
+
+static void checkByteAtATime() {
+  // ModbusMaster writes one byte per call, it is still one frame
+  HardwareSerial uart(2);
+  RS485Port port;
+  port.begin(&uart, BAUD, SERIAL_8E1, 16, 17, DE_PIN);
+
+  simAdvanceMs(10);
+  for (uint8_t i = 0; i < sizeof(kRequest); i++) {
+    SIM_CHECK(port.write(kRequest[i]) == 1);
+  }
+  port.flush();
+  SIM_CHECK(uart.sim_bytes == sizeof(kRequest));
+  SIM_CHECK(port.stats().frames == 1);
+  SIM_CHECK(port.stats().last_overhead_us <= bitUs());
+
+  // A flush() with nothing sent is not a frame
+  port.flush();
+  SIM_CHECK(port.stats().frames == 1);
+}
+
+int main() {
+  checkPlainPin();
+  checkHardwareDE();
+  checkByteAtATime();
+  checkExpanderDE();
+  checkExpanderLateFrame();
+  checkExpanderSlowSwitch();
+  checkExpanderFailure();
+
+  printf("rs485_check: %d failed\n", sim_failures);
+  return sim_failures;
+}
@@ -0,0 +1,172 @@
+/*
+  Runs SpscQueue between a producer and a consumer thread standing in
+  for the two ESP32 cores, and compares it with doing the same work on
+  one thread.
+
+  Build and run from the repository root:
+    g++ -std=gnu++11 -O2 -Wall -pthread -Itools/sim -o /tmp/spsc_queue_check \
+      tools/sim/spsc_queue_check.cpp
+    /tmp/spsc_queue_check
+
+  Every item carries a sequence number and the time it was pushed. The
+  consumer checks the order and records how long each item waited.
+  Throughput and p50 / p99 latency are printed for both runs; only
+  losses and reordering fail the check, the timings depend on the host.
+  With one host CPU the threads take turns and the threaded run can't
+  be faster.
+
+  Prints every failed check and exits with the number of failures.
+*/
+
+#include "Arduino.h"
+#include "../../modbus_master_tester/src/Pipeline/SpscQueue.hpp"
+#include <algorithm>
+
+std::atomic<uint64_t> sim_now_us(0);
+int sim_failures = 0;
+
+#define ITEMS 200000
+// Stand-ins for the bus task's read and loop()'s telemetry per item
+#define PRODUCE_NS 1000
+#define CONSUME_NS 1000
+
+struct Item {
+  uint32_t sequence;
+  std::chrono::steady_clock::time_point pushed;
+};
+
+typedef SpscQueue<Item, 32> ItemQueue;
+
+struct RunResult {
+  double items_per_s;
+  uint64_t p50_ns;
+  uint64_t p99_ns;
+  uint32_t received;
+  bool in_order;
+};
+
+static void work(uint32_t ns) {
+  std::chrono::steady_clock::time_point end =
+    std::chrono::steady_clock::now() + std::chrono::nanoseconds(ns);
+  while (std::chrono::steady_clock::now() < end) {
+  }
+}
+
+static uint64_t sinceNs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now() - start).count();
+}
+
+static void produce(ItemQueue &queue) {
+  for (uint32_t i = 0; i < ITEMS; i++) {
+    work(PRODUCE_NS);
+    Item item = { i, std::chrono::steady_clock::now() };
+    // The sketch drops on a full queue, here the producer retries so
+    // every item can be checked
+    while (!queue.push(item)) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+// Pops one item if there is one, and checks and times it
+static bool consume(ItemQueue &queue, std::vector<uint64_t> &latency_ns, RunResult &result) {
+  Item item;
+  if (!queue.pop(item)) {
+    return false;
+  }
+  latency_ns.push_back(sinceNs(item.pushed));
+  result.in_order &= item.sequence == result.received;
+  result.received++;
+  work(CONSUME_NS);
+  return true;
+}
+
+static void finish(RunResult &result, std::vector<uint64_t> &latency_ns, uint64_t elapsed_ns) {
+  result.items_per_s = elapsed_ns > 0 ? result.received * 1e9 / elapsed_ns : 0;
+  std::sort(latency_ns.begin(), latency_ns.end());
+  if (!latency_ns.empty()) {
+    result.p50_ns = latency_ns[latency_ns.size() / 2];
+    result.p99_ns = latency_ns[latency_ns.size() * 99 / 100];
+  }
+}
+
+static RunResult runSingleThread() {
+  ItemQueue queue;
+  RunResult result = {};
+  result.in_order = true;
+  std::vector<uint64_t> latency_ns;
+  latency_ns.reserve(ITEMS);
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < ITEMS; i++) {
+    work(PRODUCE_NS);
+    Item item = { i, std::chrono::steady_clock::now() };
+    queue.push(item);
+    consume(queue, latency_ns, result);
+  }
+  finish(result, latency_ns, sinceNs(start));
+  SIM_CHECK(queue.dropped() == 0);
+  return result;
+}
+
+static RunResult runThreads() {
+  ItemQueue queue;
+  RunResult result = {};
+  result.in_order = true;
+  std::vector<uint64_t> latency_ns;
+  latency_ns.reserve(ITEMS);
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::thread producer(produce, std::ref(queue));
+  while (result.received < ITEMS) {
+    if (!consume(queue, latency_ns, result)) {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+  finish(result, latency_ns, sinceNs(start));
+  SIM_CHECK(queue.depth() == 0);
+  SIM_CHECK(queue.highWater() <= 32);
+  return result;
+}
+
+static void print(const char *name, const RunResult &result) {
+  printf("%-14s %9.0f items/s  p50 %6llu ns  p99 %7llu ns\n", name, result.items_per_s,
+         (unsigned long long)result.p50_ns, (unsigned long long)result.p99_ns);
+}
+
+static void checkWrapAndDrops() {
+  // Many laps around the ring, and drops counted without blocking
+  SpscQueue<uint32_t, 4> queue;
+  uint32_t value;
+  for (uint32_t i = 0; i < 1000; i++) {
+    SIM_CHECK(queue.push(i));
+    SIM_CHECK(queue.pop(value) && value == i);
+  }
+  for (uint32_t i = 0; i < 6; i++) {
+    queue.push(i);
+  }
+  SIM_CHECK(queue.depth() == 4);
+  SIM_CHECK(queue.dropped() == 2);
+  SIM_CHECK(queue.highWater() == 4);
+  SIM_CHECK(queue.pop(value) && value == 0);
+}
+
+int main() {
+  checkWrapAndDrops();
+
+  RunResult single = runSingleThread();
+  RunResult threads = runThreads();
+  SIM_CHECK(single.received == ITEMS && single.in_order);
+  SIM_CHECK(threads.received == ITEMS && threads.in_order);
+
+  print("single thread", single);
+  print("two threads", threads);
+  printf("speedup %.2fx with %u host CPUs\n",
+         single.items_per_s > 0 ? threads.items_per_s / single.items_per_s : 0,
+         std::thread::hardware_concurrency());
+
+  printf("spsc_queue_check: %d failed\n", sim_failures);
+  return sim_failures;
+}
@@ -0,0 +1,113 @@
+/*
+  Runs the TSYS01 driver against a simulated sensor on the simulated
+  TwoWire in this directory.
+
+  Build and run from the repository root:
+    g++ -std=gnu++11 -Wall -pthread -Itools/sim -o /tmp/tsys01_check \
+      tools/sim/tsys01_check.cpp tsys01/tsys01.cpp tsys01/i2c_bus.cpp
+    /tmp/tsys01_check
+
+  Prints every failed check and exits with the number of failures.
+*/
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "../../tsys01/tsys01.h"
+
+std::atomic<uint64_t> sim_now_us(0);
+int sim_failures = 0;
+TwoWire Wire;
+
+#define TSYS01_ADDR 0x77
+
+// Calibration and ADC values of the datasheet example, 10.58 C
+static void addSensor(TwoWire &wire) {
+  const uint16_t prom[8] = { 0, 28446, 24926, 36016, 32791, 40781, 0, 0 };
+  SimI2CDevice &device = wire.sim_devices[TSYS01_ADDR];
+  for (uint8_t i = 0; i < 8; i++) {
+    device.registers[0xA0 + i * 2] = prom[i] >> 8;
+    device.registers[0xA1 + i * 2] = prom[i] & 0xFF;
+  }
+  const uint32_t adc = 9378708;
+  device.registers[0x00] = adc >> 16;
+  device.registers[0x01] = (adc >> 8) & 0xFF;
+  device.registers[0x02] = adc & 0xFF;
+}
+
+static bool near(float value, float expected) {
+  return fabsf(value - expected) < 0.01f;
+}
+
+static void checkFailedReadsKeepTheLastValue() {
+  TwoWire wire;
+  wire.transfer_us = 0;
+  addSensor(wire);
+  I2CBus bus;
+  bus.begin(&wire);
+
+  TSYS01 tsys;
+  tsys.setBus(&bus);
+  SIM_CHECK(tsys.init());
+  SIM_CHECK(tsys.read());
+  SIM_CHECK(near(tsys.temperature(), 10.58f));
+
+  // An ADC that reads 0, conversion not finished, must not turn into
+  // -611 C
+  SimI2CDevice &device = wire.sim_devices[TSYS01_ADDR];
+  uint8_t adc[3];
+  memcpy(adc, device.registers, 3);
+  memset(device.registers, 0, 3);
+  SIM_CHECK(!tsys.read());
+  SIM_CHECK(near(tsys.temperature(), 10.58f));
+  SIM_CHECK(tsys.skipped() == 1);
+  memcpy(device.registers, adc, 3);
+
+  // Nor must a sensor that stopped answering
+  device.present = false;
+  SIM_CHECK(!tsys.read());
+  SIM_CHECK(near(tsys.temperature(), 10.58f));
+  SIM_CHECK(tsys.skipped() == 2);
+
+  // Offline after a few, and then every read is skipped without a wait
+  for (uint8_t i = 0; i < I2C_HEALTH_FAIL_LIMIT; i++) {
+    tsys.read();
+  }
+  SIM_CHECK(!tsys.online());
+  uint32_t start_us = micros();
+  SIM_CHECK(!tsys.read());
+  SIM_CHECK(micros() - start_us < 1000);
+  SIM_CHECK(tsys.skipped() == I2C_HEALTH_FAIL_LIMIT + 3);
+  SIM_CHECK(near(tsys.temperature(), 10.58f));
+
+  // The next probe after the backoff brings it back
+  device.present = true;
+  simAdvanceMs(I2C_HEALTH_RETRY_MAX_MS);
+  SIM_CHECK(tsys.read());
+  SIM_CHECK(tsys.online());
+}
+
+static void checkMissingAtBoot() {
+  TwoWire wire;
+  wire.transfer_us = 0;
+  I2CBus bus;
+  bus.begin(&wire);
+
+  // No reset wait for a sensor that is not there
+  TSYS01 tsys;
+  tsys.setBus(&bus);
+  uint32_t start_us = micros();
+  SIM_CHECK(!tsys.init());
+  SIM_CHECK(micros() - start_us < TSYS01_RESET_WAIT_US);
+
+  addSensor(wire);
+  SIM_CHECK(tsys.init());
+  SIM_CHECK(tsys.read() && near(tsys.temperature(), 10.58f));
+}
+
+int main() {
+  checkFailedReadsKeepTheLastValue();
+  checkMissingAtBoot();
+
+  printf("tsys01_check: %d failed\n", sim_failures);
+  return sim_failures;
+}
@@ -0,0 +1,159 @@
+#!/usr/bin/env python3
+"""Decode the binary telemetry stream sent by the sketches' Telemetry class.
+
+Frames are COBS encoded and end with a 0x00 byte. Each decoded frame is a
+record followed by a little endian CRC-16/MODBUS of the record. See
+src/Telemetry/Telemetry.hpp in the sketches for the record layout.
+
+Usage:
+    telemetry_decode.py /dev/ttyUSB0 [--baud 115200]   (needs pyserial)
+    telemetry_decode.py capture.bin
+    cat capture.bin | telemetry_decode.py -
+"""
+
+import argparse
+import struct
+import sys
+
+SAMPLE = 0x01
+MODBUS_RESULT = 0x02
+GPIO_EVENT = 0x03
+TASK_STATS = 0x04
+
+
+def crc16_modbus(data):
+    crc = 0xFFFF
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            if crc & 1:
+                crc = (crc >> 1) ^ 0xA001
+            else:
+                crc >>= 1
+    return crc
+
+
+def cobs_decode(frame):
+    out = bytearray()
+    i = 0
+    while i < len(frame):
+        code = frame[i]
+        if code == 0 or i + code > len(frame):
+            raise ValueError("bad COBS code")
+        out += frame[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < len(frame):
+            out.append(0)
+    return bytes(out)
+
+
+def decode_record(record):
+    """Returns a dict for one CRC-checked record, or raises ValueError."""
+    if len(record) < 8:
+        raise ValueError("short record")
+    body, crc = record[:-2], struct.unpack("<H", record[-2:])[0]
+    if crc16_modbus(body) != crc:
+        raise ValueError("CRC mismatch")
+
+    rtype, seq, timestamp_ms = struct.unpack_from("<BBI", body)
+    data = body[6:]
+    result = {"seq": seq, "t_ms": timestamp_ms}
+
+    if rtype == SAMPLE:
+        sensor, milli_c = struct.unpack("<Bi", data)
+        result.update(type="sample", sensor=sensor, temp_c=milli_c / 1000.0)
+    elif rtype == MODBUS_RESULT:
+        server_id, function_code, code, count = struct.unpack_from("<BBBB", data)
+        registers = list(struct.unpack_from("<%dH" % count, data, 4))
+        result.update(type="modbus", server_id=server_id,
+                      function_code=function_code, result=code,
+                      registers=registers)
+    elif rtype == GPIO_EVENT:
+        device, pins, changed = struct.unpack("<BHH", data)
+        result.update(type="gpio", device=device, pins=pins, changed=changed)
+    elif rtype == TASK_STATS:
+        task, runs, mean_us, max_us, misses = struct.unpack("<BIIII", data)
+        result.update(type="task", task=task, runs=runs, mean_us=mean_us,
+                      max_us=max_us, misses=misses)
+    else:
+        raise ValueError("unknown record type 0x%02X" % rtype)
+    return result
+
+
+def format_record(r):
+    head = "%10d #%3d " % (r["t_ms"], r["seq"])
+    if r["type"] == "sample":
+        return head + "SAMPLE  sensor %d: %.3f C" % (r["sensor"], r["temp_c"])
+    if r["type"] == "modbus":
+        regs = " ".join("%04X" % v for v in r["registers"])
+        return head + "MODBUS  id %d fc 0x%02X result 0x%02X [%s]" % (
+            r["server_id"], r["function_code"], r["result"], regs)
+    if r["type"] == "task":
+        return head + "TASK    %d: runs %d mean %d us max %d us missed %d" % (
+            r["task"], r["runs"], r["mean_us"], r["max_us"], r["misses"])
+    return head + "GPIO    dev 0x%02X pins %04X changed %04X" % (
+        r["device"], r["pins"], r["changed"])
+
+
+def read_chunk(stream):
+    """Returns whatever has arrived, blocking only until the first byte."""
+    waiting = getattr(stream, "in_waiting", None)
+    if waiting is not None:
+        # pyserial: read(n) would block until all n bytes are in
+        return stream.read(waiting or 1)
+    if hasattr(stream, "read1"):
+        return stream.read1(256)
+    return stream.read(256)
+
+
+def frames(stream):
+    """Yields raw frames split on 0x00 delimiters."""
+    pending = bytearray()
+    while True:
+        chunk = read_chunk(stream)
+        if not chunk:
+            break
+        for byte in chunk:
+            if byte == 0:
+                if pending:
+                    yield bytes(pending)
+                pending.clear()
+            else:
+                pending.append(byte)
+
+
+def open_input(args):
+    if args.source == "-":
+        return sys.stdin.buffer
+    if args.source.startswith("/dev/") or args.source.upper().startswith("COM"):
+        import serial  # pyserial
+        return serial.Serial(args.source, args.baud, timeout=None)
+    return open(args.source, "rb")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source", help="serial port, capture file, or - for stdin")
+    parser.add_argument("--baud", type=int, default=115200)
+    args = parser.parse_args()
+
+    good = bad = 0
+    try:
+        for frame in frames(open_input(args)):
+            try:
+                record = decode_record(cobs_decode(frame))
+            except (ValueError, struct.error) as err:
+                # Text output or line noise between frames
+                bad += 1
+                if args.source != "-":
+                    print("# dropped frame (%s)" % err, file=sys.stderr)
+                continue
+            good += 1
+            print(format_record(record), flush=True)
+    except KeyboardInterrupt:
+        pass
+    print("# %d frames decoded, %d dropped" % (good, bad), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
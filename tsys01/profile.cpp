@@ -0,0 +1,43 @@
+#include "profile.h"
+
+ProfileProbe *ProfileProbe::_first = NULL;
+
+ProfileProbe::ProfileProbe(const char *name)
+  : _name(name), _next(_first) {
+  reset();
+  _first = this;
+}
+
+void ProfileProbe::reset() {
+  memset(_buckets, 0, sizeof(_buckets));
+  _count = 0;
+  _max = 0;
+  _total = 0;
+}
+
+void ProfileProbe::dump(Print &out) const {
+  if (_count == 0) {
+    out.printf("PROFILE %s: no samples\n", _name);
+    return;
+  }
+
+  out.printf("PROFILE %s: n %u mean %u max %u ticks\n",
+             _name, _count, (uint32_t)(_total / _count), _max);
+  for (uint8_t i = 0; i < PROFILE_BUCKETS; i++) {
+    if (_buckets[i] > 0) {
+      out.printf("  >= %10u: %u\n", (uint32_t)1 << i, _buckets[i]);
+    }
+  }
+}
+
+void ProfileProbe::dumpAll(Print &out) {
+  for (ProfileProbe *probe = _first; probe != NULL; probe = probe->_next) {
+    probe->dump(out);
+  }
+}
+
+void ProfileProbe::resetAll() {
+  for (ProfileProbe *probe = _first; probe != NULL; probe = probe->_next) {
+    probe->reset();
+  }
+}
@@ -0,0 +1,125 @@
+/*
+  Hot-path timing probes.
+
+  A probe keeps a log2 histogram of how long a block of code takes:
+  bucket n counts runs of 2^n to 2^(n+1) - 1 ticks. A tick is a CPU
+  cycle on the ESP32 and a nanosecond of steady_clock elsewhere.
+  Recording is a handful of instructions and never allocates, so probes
+  can stay in production builds.
+
+    PROFILE_PROBE(send_message);     // once, at file scope
+
+    void send_message() {
+      PROFILE_SCOPE(send_message);   // times the rest of the block
+      ...
+    }
+
+    PROFILE_DUMP(Serial);            // print every probe
+
+  Build with -DPROFILE_ENABLED=1 to turn probes on. Otherwise the macros
+  expand to nothing and no code or strings are generated.
+
+  A probe must only be recorded from one task at a time.
+*/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "Arduino.h"
+
+#ifndef PROFILE_ENABLED
+#define PROFILE_ENABLED 0
+#endif
+
+#define PROFILE_BUCKETS 32
+
+#if !defined(ARDUINO)
+#include <chrono>
+#endif
+
+/**
+ * @brief Current time in profile ticks.
+ */
+inline uint32_t profileTicks() {
+#if defined(ARDUINO)
+  return ESP.getCycleCount();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+           std::chrono::steady_clock::now().time_since_epoch())
+    .count();
+#endif
+}
+
+class ProfileProbe {
+public:
+  /**
+   * @brief Registers the probe so dumpAll() can find it.
+   *
+   * @param name A string literal, it is referenced, not copied.
+   */
+  explicit ProfileProbe(const char *name);
+
+  /**
+   * @brief Adds one run to the histogram.
+   */
+  void record(uint32_t ticks) {
+    uint8_t bucket = ticks == 0 ? 0 : 31 - __builtin_clz(ticks);
+    _buckets[bucket]++;
+    _count++;
+    _total += ticks;
+    if (ticks > _max) {
+      _max = ticks;
+    }
+  }
+
+  void reset();
+  void dump(Print &out) const;
+
+  /**
+   * @brief Prints or clears every registered probe.
+   */
+  static void dumpAll(Print &out);
+  static void resetAll();
+
+private:
+  const char *_name;
+  uint32_t _buckets[PROFILE_BUCKETS];
+  uint32_t _count;
+  uint32_t _max;
+  uint64_t _total;
+
+  // Registered probes, in construction order
+  ProfileProbe *_next;
+  static ProfileProbe *_first;
+};
+
+/*
+  Records the time from construction to the end of the enclosing scope.
+*/
+class ProfileScope {
+public:
+  explicit ProfileScope(ProfileProbe &probe)
+    : _probe(probe), _start(profileTicks()) {}
+
+  ~ProfileScope() {
+    _probe.record(profileTicks() - _start);
+  }
+
+private:
+  ProfileProbe &_probe;
+  uint32_t _start;
+};
+
+#if PROFILE_ENABLED
+#define PROFILE_PROBE(name) ProfileProbe profile_probe_##name(#name)
+#define PROFILE_SCOPE(name) ProfileScope profile_scope_##name(profile_probe_##name)
+#define PROFILE_DUMP(out) ProfileProbe::dumpAll(out)
+#define PROFILE_RESET() ProfileProbe::resetAll()
+#else
+#define PROFILE_PROBE(name)
+#define PROFILE_SCOPE(name)
+#define PROFILE_DUMP(out)
+#define PROFILE_RESET()
+#endif
+
+#endif
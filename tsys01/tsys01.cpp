@@ -1,4 +1,6 @@
 #include "tsys01.h"
+#include "log_level.h"
+#include "profile.h"
 #include <Wire.h>
 
 #define TSYS01_ADDR 0x77
@@ -7,50 +9,231 @@
 #define TSYS01_ADC_TEMP_CONV 0x48
 #define TSYS01_PROM_READ 0XA0
 
+// Adaptive conversion timing, in microseconds
+#define TSYS01_CONV_MAX_US 10000   // Max conversion time per datasheet
+#define TSYS01_CONV_MIN_US 1000    // Never learn a time shorter than this
+#define TSYS01_CONV_MARGIN_US 200  // Added to the learned time before reading
+#define TSYS01_CONV_RETRY_US 250   // Poll interval when the ADC is not ready
+#define TSYS01_CONV_PROBE_US 100   // Step down after a first-try success
+
+// Sleeps through most of a wait so other tasks on the core can run, and
+// busy-waits only the last part, which delay() cannot time exactly
+static void waitUs(uint32_t wait_us) {
+  uint32_t start = micros();
+  if (wait_us > 2000) {
+    delay(wait_us / 1000 - 1);
+  }
+  uint32_t elapsed = micros() - start;
+  if (elapsed < wait_us) {
+    delayMicroseconds(wait_us - elapsed);
+  }
+}
+
 TSYS01::TSYS01() {
+  _wire = &Wire;
+  _bus = NULL;
+  _adaptive = false;
+  _conv_start_us = 0;
+  _stats.last_us = 0;
+  _stats.min_us = UINT32_MAX;
+  _stats.max_us = 0;
+  _stats.learned_us = TSYS01_CONV_MAX_US;
+  _stats.samples = 0;
+  _stats.retries = 0;
 }
 
 bool TSYS01::init() {
+  if (!reset()) {
+    return false;
+  }
+  waitUs(TSYS01_RESET_WAIT_US);
+  return readCalibration();
+}
+
+bool TSYS01::reset() {
   // Reset the TSYS01, per datasheet
-  Wire.beginTransmission(TSYS01_ADDR);
-  Wire.write(TSYS01_RESET);
-  Wire.endTransmission();
+  I2CTransaction transaction(_bus, TSYS01_ADDR);
+  _wire->beginTransmission(TSYS01_ADDR);
+  _wire->write(TSYS01_RESET);
+  bool ok = _wire->endTransmission() == 0;
+  _health.record(ok);
+  return ok;
+}
 
-  delay(10);
+bool TSYS01::readCalibration() {
+  I2CTransaction transaction(_bus, TSYS01_ADDR);
   int received_bytes = 0;
   // Read calibration values
   for (uint8_t i = 0; i < 8; i++) {
-    Wire.beginTransmission(TSYS01_ADDR);
-    Wire.write(TSYS01_PROM_READ + i * 2);
-    Wire.endTransmission();
-
-    received_bytes += Wire.requestFrom(TSYS01_ADDR, 2);
-    C[i] = (Wire.read() << 8) | Wire.read();
+    uint8_t prom[2] = { 0, 0 };
+    received_bytes += i2cWriteRead(_wire, TSYS01_ADDR, TSYS01_PROM_READ + i * 2, prom, 2);
+    C[i] = (prom[0] << 8) | prom[1];
   }
+  _health.record(received_bytes > 0);
   return received_bytes > 0;
 }
 
-void TSYS01::read() {
+void TSYS01::setBus(I2CBus *bus) {
+  _bus = bus;
+  _wire = bus->wire();
+}
 
-  Wire.beginTransmission(TSYS01_ADDR);
-  Wire.write(TSYS01_ADC_TEMP_CONV);
-  Wire.endTransmission();
+PROFILE_PROBE(tsys01_read);
 
-  delay(10);  // Max conversion time per datasheet
+bool TSYS01::read() {
+  PROFILE_SCOPE(tsys01_read);
 
-  Wire.beginTransmission(TSYS01_ADDR);
-  Wire.write(TSYS01_ADC_READ);
-  Wire.endTransmission();
+  if (!startConversion()) {
+    _health.skip();
+    return false;
+  }
+  bool ok = fetch();
 
-  Wire.requestFrom(TSYS01_ADDR, 3);
-  D1 = 0;
-  D1 = Wire.read();
-  D1 = (D1 << 8) | Wire.read();
-  D1 = (D1 << 8) | Wire.read();
+  LOG_PRINTF(SENSOR, DEBUG, "D1: %d\n", D1);
+  return ok;
+}
 
-  Serial.printf("D1: %d\n", D1);
+void TSYS01::setAdaptive(bool enable) {
+  _adaptive = enable;
+}
+
+bool TSYS01::startConversion() {
+  if (!_health.ready()) {
+    return false;
+  }
+
+  I2CTransaction transaction(_bus, TSYS01_ADDR);
+  _wire->beginTransmission(TSYS01_ADDR);
+  _wire->write(TSYS01_ADC_TEMP_CONV);
+  bool ok = _wire->endTransmission() == 0;
+  _health.record(ok);
+
+  _conv_start_us = micros();
+  return ok;
+}
+
+void TSYS01::conversionStarted(uint32_t start_us) {
+  _conv_start_us = start_us;
+}
+
+bool TSYS01::ready() {
+  uint32_t wait_us = TSYS01_CONV_MAX_US;
+  if (_adaptive) {
+    wait_us = _stats.learned_us + TSYS01_CONV_MARGIN_US;
+  }
+  return micros() - _conv_start_us >= wait_us;
+}
+
+bool TSYS01::fetch() {
+  if (!_health.ready()) {
+    _health.skip();
+    return false;
+  }
+
+  bool ready;
+  if (_adaptive) {
+    ready = waitForConversion();
+  } else {
+    // Max conversion time per datasheet
+    uint32_t elapsed = micros() - _conv_start_us;
+    if (elapsed < TSYS01_CONV_MAX_US) {
+      waitUs(TSYS01_CONV_MAX_US - elapsed);
+    }
+    ready = readAdc();
+  }
 
+  // Keep the last good temperature, D1 is 0 after a failed read
+  if (!ready) {
+    _health.skip();
+    return false;
+  }
   calculate();
+  return true;
+}
+
+bool TSYS01::fetchResult() {
+  if (!readAdc()) {
+    _health.skip();
+    return false;
+  }
+  calculate();
+  return true;
+}
+
+bool TSYS01::readAdc() {
+  D1 = 0;
+  if (!_health.ready()) {
+    return false;
+  }
+
+  I2CTransaction transaction(_bus, TSYS01_ADDR);
+  uint8_t adc_bytes[3];
+  bool received = i2cWriteRead(_wire, TSYS01_ADDR, TSYS01_ADC_READ, adc_bytes, 3) == 3;
+  _health.record(received);
+  if (received) {
+    D1 = ((uint32_t)adc_bytes[0] << 16) | ((uint32_t)adc_bytes[1] << 8) | adc_bytes[2];
+  }
+
+  // The ADC reads 0 while a conversion is still running
+  return D1 != 0;
+}
+
+bool TSYS01::waitForConversion() {
+  uint32_t wait_us = _stats.learned_us + TSYS01_CONV_MARGIN_US;
+  uint32_t elapsed = micros() - _conv_start_us;
+  if (elapsed < wait_us) {
+    waitUs(wait_us - elapsed);
+  }
+
+  bool first_try = true;
+  while (!readAdc()) {
+    if (_health.failures() > 0) {
+      // No answer at all, polling until the timeout will not help
+      return false;
+    }
+    first_try = false;
+    _stats.retries++;
+    if (micros() - _conv_start_us >= TSYS01_CONV_MAX_US + TSYS01_CONV_MARGIN_US) {
+      // Give up, the sensor should have finished long ago
+      _stats.learned_us = TSYS01_CONV_MAX_US;
+      return false;
+    }
+    delayMicroseconds(TSYS01_CONV_RETRY_US);
+  }
+  elapsed = micros() - _conv_start_us;
+
+  _stats.last_us = elapsed;
+  if (elapsed < _stats.min_us) {
+    _stats.min_us = elapsed;
+  }
+  if (elapsed > _stats.max_us) {
+    _stats.max_us = elapsed;
+  }
+  _stats.samples++;
+
+  // A first-try success only tells us the conversion was done by now, so
+  // probe a little earlier next time. After a retry the elapsed time is
+  // the best estimate we have.
+  if (first_try) {
+    if (_stats.learned_us > TSYS01_CONV_MIN_US + TSYS01_CONV_PROBE_US) {
+      _stats.learned_us -= TSYS01_CONV_PROBE_US;
+    }
+  } else {
+    _stats.learned_us = elapsed;
+  }
+  return true;
+}
+
+const TSYS01_ConversionStats& TSYS01::conversionStats() {
+  return _stats;
+}
+
+bool TSYS01::online() {
+  return _health.online();
+}
+
+uint32_t TSYS01::skipped() {
+  return _health.skipped();
 }
 
 void TSYS01::readTestCase() {
@@ -1,6 +1,20 @@
 #include <Wire.h>
 #include "tsys01.h"
+#include "i2c_bus.h"
+#include "temp_filter.h"
+#include "sample_ring.h"
+#include "profile.h"
 TSYS01 tsys;
+// The TSYS01 supports 400 kHz
+I2CBus i2c_bus;
+const uint32_t tsys_clock_hz = 400000;
+TempFilter tsys_filter;
+// Last minute of filtered samples, at roughly 8 per second
+SampleRing<512> tsys_history;
+
+// Sample as fast as the sensor converts, report once a second
+const unsigned long report_interval = 1000;
+unsigned long last_report_time = 0;
 
 #define TSYS01_ADDR 0x77
 #define TSYS01_RESET 0x1E
@@ -80,14 +94,49 @@ void tsys_read() {
 void setup() {
   Serial.begin(115200);
   Wire.begin(I2C_SDA, I2C_SCL);
+  i2c_bus.begin(&Wire);
+  i2c_bus.setDeviceClock(TSYS01_ADDR, tsys_clock_hz);
+
+  tsys.setBus(&i2c_bus);
+  if (!tsys.init()) {
+    Serial.println("TSYS01 not found!");
+  }
+  tsys.setAdaptive(true);
 
-  tsys_init();
+  // Average 8 conversions, reject spikes over 3 outputs, alpha = 1/4
+  tsys_filter.configure(8, 3, 2);
 }
 
 void loop() {
 
-  tsys_1.read();
-  float temp = tsys.temperature();
-  Serial.printf("TEMP C: %.2f\n", temp);
-  delay(1000);
+  // A failed read is skipped rather than filtered in
+  if (tsys.read() && tsys_filter.push((int32_t)(tsys.temperature() * 1000.0f))) {
+    tsys_history.push(millis(), tsys_filter.value());
+  }
+
+  if (millis() - last_report_time < report_interval) {
+    return;
+  }
+  last_report_time = millis();
+
+  float temp = tsys_filter.value() / 1000.0f;
+  Serial.printf("TEMP C: %.2f%s\n", temp, tsys.online() ? "" : " (offline)");
+
+  SampleStats history;
+  if (tsys_history.snapshot(history)) {
+    Serial.printf("WINDOW n %u min %.2f max %.2f mean %.3f var %.5f\n",
+                  history.count, history.min / 1000.0f, history.max / 1000.0f,
+                  history.mean / 1000.0f, history.variance / 1000000.0f);
+  }
+
+  const TSYS01_ConversionStats& stats = tsys.conversionStats();
+  Serial.printf("CONV us: last %u min %u max %u learned %u retries %u\n",
+                stats.last_us, stats.min_us, stats.max_us,
+                stats.learned_us, stats.retries);
+  Serial.printf("SKIPPED: %u\n", tsys.skipped());
+
+  // Send 'p' to dump the timing histograms
+  if (Serial.read() == 'p') {
+    PROFILE_DUMP(Serial);
+  }
 }